@@ -25,17 +25,32 @@ def run_benchmark(benchmark, input_files):
             print(f"Error parsing json output for {input_file}")
     return results
 
+def run_benchmark_batch(benchmark, input, threads):
+    # One process for all the input files, which prints one json line per file
+    print(f"Running {benchmark} on batch {input} with {threads} threads")
+    output = subprocess.run([benchmark, "--threads", str(threads), "--batch", input],
+                            stdout=subprocess.PIPE).stdout.decode('utf-8')
+    records = [json.loads(line) for line in output.split('\n') if line.startswith('{')]
+    # The last line sums up the batch
+    return [record for record in records if "graph" in record]
+
 def main():
     parser = argparse.ArgumentParser(description='Run a benchmark on a list or directory of input files')
     parser.add_argument('benchmark', type=str, help='Path to the benchmark executable')
     parser.add_argument('-i', '--input', type=str, help='A list of input files or a directory of input files')
     parser.add_argument('-o', '--output', default="out.csv", type=str, help='Path to save the output dataframe')
+    parser.add_argument('-b', '--batch', default=0, type=int,
+                        help='Run a directory or manifest of input files in one process, on this many threads')
     args = parser.parse_args()
 
     df = pd.DataFrame()
     # If input is a csv file, don't run the benchmark, just use results in that file for analysis
     if args.input.endswith('.csv'):
         df = pd.read_csv(args.input)
+    elif args.batch > 0:
+        results = run_benchmark_batch(args.benchmark, args.input, args.batch)
+        df = pd.DataFrame(results)
+        df.to_csv(args.output, index=False)
     else:
         if os.path.isfile(args.input):
             results = run_benchmark(args.benchmark, [args.input])
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <lemon/list_graph.h>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include "dimacs_reader.hpp"
+#include "edge_list.hpp"
+#include "graph_cache.hpp"
+#include "k_min_cut.hpp"
+#include "lemon_preflow.hpp"
+#include "microbench.hpp"
+#include "util.hpp"
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "data"
+#endif
+
+using namespace lemon;
+namespace fs = std::filesystem;
+
+// Component benchmarks of the pipeline, on every graph of the
+// data/GTGraph-rand-sweep* families. Each graph gets one benchmark per
+// component, named component/family/graph:
+//   read_dimacs       parse the DIMACS file
+//   read_cache        load its graph cache
+//   preprocess        simplify the edge list and fill the lemon graph
+//   preflow_st        one Preflow min cut between the first and last nodes
+//   gomory_hu         Gusfield's tree
+//   gomory_hu_2       the tree by supernode splits
+//   min_k_cut_value   the min k-cut value on a built tree
+//   min_k_cut_map     the min k-cut map on a built tree
+// Throughputs are in edges of the simple graph per second, or of the file
+// for the readers.
+
+struct bench_options
+{
+    std::string data_dir = BENCH_DATA_DIR;
+    std::string filter;
+    std::string json_file;
+    double min_time = 0.2;
+    // Graphs with more nodes are skipped, if not 0
+    int max_nodes = 4096;
+    unsigned int k = 3;
+};
+
+// A graph of a family, loaded once for all its benchmarks
+struct bench_graph
+{
+    std::string name;
+    std::string path;
+    std::string cache_path;
+    int n = 0;
+    // As read, then simple
+    std::vector<csr_graph::edge> raw_edges;
+    std::vector<csr_graph::edge> edges;
+};
+
+void add_benchmarks(bench_suite& suite, bench_graph const& bg,
+    bench_options const& options)
+{
+    std::size_t const n_raw = bg.raw_edges.size();
+    std::size_t const m = bg.edges.size();
+
+    suite.add("read_dimacs/" + bg.name, [&bg, n_raw](bench_state& state) {
+        int n;
+        std::vector<csr_graph::edge> edges;
+        while (state.next())
+        {
+            readDimacsEdges(bg.path, n, edges);
+        }
+        state.set_items(n_raw);
+    });
+
+    suite.add("read_cache/" + bg.name, [&bg, m](bench_state& state) {
+        std::vector<csr_graph::edge> edges;
+        while (state.next())
+        {
+            graph_cache cache;
+            cache.open(bg.cache_path);
+            cache.edges(edges);
+        }
+        state.set_items(m);
+    });
+
+    suite.add("preprocess/" + bg.name, [&bg, n_raw](bench_state& state) {
+        std::vector<csr_graph::edge> edges;
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        while (state.next())
+        {
+            state.pause();
+            edges = bg.raw_edges;
+            state.resume();
+            simplify_edges(bg.n, edges);
+            fill_graph(g, weights, bg.n, edges);
+        }
+        state.set_items(n_raw);
+    });
+
+    suite.add("preflow_st/" + bg.name, [&bg, m](bench_state& state) {
+        csr_graph csr;
+        csr.build(bg.n, bg.edges);
+        lemon_preflow flow;
+        while (state.next())
+        {
+            flow.run(csr, 0, bg.n - 1);
+        }
+        state.set_items(m);
+    });
+
+    // The trees are built from scratch at every iteration
+    auto add_tree_benchmark = [&](std::string const& name, bool splits) {
+        suite.add(name + "/" + bg.name, [&bg, m, splits](bench_state& state) {
+            ListGraph g;
+            ListGraph::EdgeMap<int> weights(g);
+            fill_graph(g, weights, bg.n, bg.edges);
+            std::optional<k_min_cut<>> kmc;
+            while (state.next())
+            {
+                state.pause();
+                kmc.emplace(g, weights);
+                state.resume();
+                if (splits)
+                    kmc->run_gomory_hu_2();
+                else
+                    kmc->run_gomory_hu();
+            }
+            state.set_items(m);
+        });
+    };
+    add_tree_benchmark("gomory_hu", false);
+    add_tree_benchmark("gomory_hu_2", true);
+
+    unsigned int const k = options.k;
+    suite.add("min_k_cut_value/" + bg.name, [&bg, m, k](bench_state& state) {
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        fill_graph(g, weights, bg.n, bg.edges);
+        k_min_cut<> kmc(g, weights);
+        kmc.run_gomory_hu_2();
+        while (state.next())
+        {
+            do_not_optimize(kmc.min_k_cut_value(k));
+        }
+        state.set_items(m);
+    });
+
+    suite.add("min_k_cut_map/" + bg.name, [&bg, m, k](bench_state& state) {
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        fill_graph(g, weights, bg.n, bg.edges);
+        k_min_cut<> kmc(g, weights);
+        kmc.run_gomory_hu_2();
+        ListGraph::NodeMap<unsigned int> cut_map(g);
+        while (state.next())
+        {
+            kmc.min_k_cut_map(k, cut_map);
+        }
+        state.set_items(m);
+    });
+}
+
+// Load the DIMACS graphs of the data/GTGraph-rand-sweep* families, by
+// family then file name, and write their caches to a temporary directory
+bool load_graphs(bench_options const& options, fs::path const& cache_dir,
+    std::vector<bench_graph>& graphs)
+{
+    std::error_code error;
+    std::vector<fs::path> families;
+    for (fs::directory_entry const& entry :
+        fs::directory_iterator(options.data_dir, error))
+    {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory() && name.rfind("GTGraph-rand-sweep", 0) == 0)
+            families.push_back(entry.path());
+    }
+    if (error || families.empty())
+    {
+        std::cerr << "No GTGraph-rand-sweep* family in " << options.data_dir
+                  << std::endl;
+        return false;
+    }
+    std::sort(families.begin(), families.end());
+
+    for (fs::path const& family : families)
+    {
+        std::vector<fs::path> files;
+        for (fs::directory_entry const& entry :
+            fs::directory_iterator(family))
+        {
+            if (entry.path().extension() == ".gr")
+                files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+        for (fs::path const& file : files)
+        {
+            bench_graph bg;
+            bg.name = family.filename().string() + "/" + file.stem().string();
+            bg.path = file.string();
+            if (!readDimacsEdges(bg.path, bg.n, bg.raw_edges))
+                return false;
+            if (bg.n < 2 || (options.max_nodes > 0 && bg.n > options.max_nodes))
+                continue;
+            bg.edges = bg.raw_edges;
+            simplify_edges(bg.n, bg.edges);
+
+            bg.cache_path =
+                (cache_dir / (family.filename().string() + "-" +
+                                 file.stem().string() + ".cache"))
+                    .string();
+            csr_graph csr;
+            csr.build(bg.n, bg.edges);
+            if (!writeGraphCache(csr, bg.cache_path))
+                return false;
+            graphs.push_back(std::move(bg));
+        }
+    }
+    return true;
+}
+
+// A new directory in the temporary directory, that no other run uses
+fs::path make_cache_dir()
+{
+    std::random_device random;
+    while (true)
+    {
+        fs::path dir = fs::temp_directory_path() /
+            ("bench_kcut-" + std::to_string(random()));
+        if (fs::create_directory(dir))
+            return dir;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench_options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc)
+        {
+            options.data_dir = argv[++i];
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--json" && i + 1 < argc)
+        {
+            options.json_file = argv[++i];
+        }
+        else if (arg == "--min-time" && i + 1 < argc)
+        {
+            options.min_time = std::stod(argv[++i]);
+        }
+        else if (arg == "--max-nodes" && i + 1 < argc)
+        {
+            options.max_nodes = std::stoi(argv[++i]);
+        }
+        else if (arg == "--k" && i + 1 < argc)
+        {
+            options.k = std::max(2, std::stoi(argv[++i]));
+        }
+        else
+        {
+            std::cout << "Component benchmarks of the min k-cut pipeline"
+                      << std::endl;
+            std::cout << "Usage: " << argv[0]
+                      << " [--data <dir>] [--filter <substring>]"
+                         " [--json <file>] [--min-time <s>]"
+                         " [--max-nodes <n>] [--k <k>]"
+                      << std::endl;
+            std::cout << "--max-nodes 0 runs every graph; the default skips "
+                         "those above 4096 nodes"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    fs::path cache_dir = make_cache_dir();
+    std::vector<bench_graph> graphs;
+    if (!load_graphs(options, cache_dir, graphs))
+    {
+        fs::remove_all(cache_dir);
+        return 1;
+    }
+
+    bench_suite suite;
+    suite.set_min_time(options.min_time);
+    for (bench_graph const& bg : graphs)
+    {
+        add_benchmarks(suite, bg, options);
+    }
+    suite.run(options.filter);
+    fs::remove_all(cache_dir);
+
+    if (!options.json_file.empty())
+    {
+        std::ofstream json(options.json_file);
+        suite.write_json(json);
+        if (!json)
+        {
+            std::cerr << "Cannot write " << options.json_file << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+// A small microbenchmark harness. A benchmark is a function that runs the
+// code to measure in a loop on a bench_state:
+//
+//     suite.add("name", [](bench_state& state) {
+//         while (state.next())
+//             work();
+//     });
+//
+// and can pause the clock around setup code. It is run with more and more
+// iterations until one run takes min_time; the time per iteration of that
+// run is reported, with the throughput of the items (edges) it processed.
+// What the code logs to global_json_logger is dropped, and results it does
+// not use otherwise go to do_not_optimize, so that they are computed.
+
+// Make the compiler assume that value is read, so that the code computing it
+// is not removed
+template <typename T>
+inline void do_not_optimize(T const& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static void const* volatile sink;
+    sink = &value;
+#endif
+}
+
+class bench_state
+{
+    using clock = std::chrono::steady_clock;
+
+    std::size_t _n_iterations;
+    std::size_t _i = 0;
+    clock::time_point _start;
+    clock::duration _elapsed{0};
+    bool _running = false;
+    std::size_t _items = 0;
+
+public:
+    explicit bench_state(std::size_t n_iterations) : _n_iterations(n_iterations)
+    {
+    }
+
+    // Start the next iteration; false when they are all done
+    bool next()
+    {
+        if (_i == 0)
+            resume();
+        if (_i++ < _n_iterations)
+            return true;
+        pause();
+        return false;
+    }
+
+    // Stop the clock, for setup code inside the loop
+    void pause()
+    {
+        if (_running)
+            _elapsed += clock::now() - _start;
+        _running = false;
+    }
+
+    void resume()
+    {
+        if (!_running)
+            _start = clock::now();
+        _running = true;
+    }
+
+    // The items processed by one iteration, for the throughput
+    void set_items(std::size_t items)
+    {
+        _items = items;
+    }
+
+    std::size_t n_iterations() const
+    {
+        return _n_iterations;
+    }
+
+    std::size_t items() const
+    {
+        return _items;
+    }
+
+    // Measured time of the whole run (s)
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(_elapsed).count();
+    }
+};
+
+class bench_suite
+{
+public:
+    using function = std::function<void(bench_state&)>;
+
+    struct result
+    {
+        std::string name;
+        std::size_t n_iterations = 0;
+        // Time per iteration (s)
+        double time = 0;
+        std::size_t items = 0;
+        double items_per_second = 0;
+    };
+
+private:
+    std::vector<std::pair<std::string, function>> _benchmarks;
+    std::vector<result> _results;
+    double _min_time = 0.2;
+    std::size_t _max_iterations = 100000;
+
+    result run_one(std::string const& name, function const& f) const
+    {
+        std::size_t n = 1;
+        while (true)
+        {
+            bench_state state(n);
+            {
+                json_logger::discard discard;
+                f(state);
+            }
+            double t = state.elapsed();
+            if (t >= _min_time || n >= _max_iterations)
+            {
+                result r;
+                r.name = name;
+                r.n_iterations = n;
+                r.time = t / n;
+                r.items = state.items();
+                r.items_per_second = t > 0 ? double(r.items) * n / t : 0;
+                return r;
+            }
+            // Aim a bit past min_time, growing at most tenfold
+            double scale = t > 0 ? 1.4 * _min_time / t : 10;
+            n = std::min(_max_iterations,
+                std::max(n + 1, std::size_t(n * std::min(scale, 10.0))));
+        }
+    }
+
+public:
+    void add(std::string name, function f)
+    {
+        _benchmarks.emplace_back(std::move(name), std::move(f));
+    }
+
+    // The time a measured run must take at least (s)
+    void set_min_time(double min_time)
+    {
+        _min_time = min_time;
+    }
+
+    // Run the benchmarks whose name contains filter, and print a line each
+    void run(std::string const& filter = "", std::ostream& os = std::cout)
+    {
+        os << std::left << std::setw(48) << "benchmark" << std::right
+           << std::setw(12) << "iterations" << std::setw(14) << "time (s)"
+           << std::setw(14) << "edges/s" << std::endl;
+        for (auto const& [name, f] : _benchmarks)
+        {
+            if (name.find(filter) == std::string::npos)
+                continue;
+            result r = run_one(name, f);
+            os << std::left << std::setw(48) << r.name << std::right
+               << std::setw(12) << r.n_iterations << std::setw(14)
+               << std::setprecision(4) << r.time << std::setw(14)
+               << std::setprecision(4) << r.items_per_second << std::endl;
+            _results.push_back(r);
+        }
+    }
+
+    std::vector<result> const& results() const
+    {
+        return _results;
+    }
+
+    // Write the results as a JSON array of objects, one per benchmark
+    void write_json(std::ostream& os) const
+    {
+        os << "[\n";
+        for (std::size_t i = 0; i < _results.size(); ++i)
+        {
+            result const& r = _results[i];
+            os << "  {\"name\": \"" << r.name << "\", \"iterations\": "
+               << r.n_iterations << ", \"time\": " << std::setprecision(9)
+               << r.time << ", \"edges\": " << r.items
+               << ", \"edges_per_second\": " << r.items_per_second << "}"
+               << (i + 1 < _results.size() ? ",\n" : "\n");
+        }
+        os << "]" << std::endl;
+    }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+// The graph files of a batch: the files of a directory, by name, or the
+// lines of a manifest file, without blank lines and # comments
+inline bool batch_files(
+    std::string const& input, std::vector<std::string>& files)
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (fs::is_directory(input, error))
+    {
+        for (fs::directory_entry const& entry :
+            fs::directory_iterator(input, error))
+        {
+            if (entry.is_regular_file(error) &&
+                entry.path().filename().string()[0] != '.')
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        return !error;
+    }
+    std::ifstream manifest(input);
+    if (!manifest)
+    {
+        std::cerr << "Cannot open batch " << input << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() && line[0] != '#')
+            files.push_back(line);
+    }
+    return true;
+}
+
+// Run a job per file on a pool of n_workers workers, and write one JSON
+// record per job to os, in the order they finish, with its file in "graph"
+// and its exit status in "status". Returns the number of jobs that failed.
+//
+// A job loads its graph by load(file, n, edges), which returns false on
+// failure, then runs run(n, edges), which returns the exit status, on one
+// thread. What both log to global_json_logger goes to the record of the
+// job. A loader thread loads the graphs ahead of the workers, at most two
+// per worker, so parsing overlaps computing.
+template <typename Load, typename Run>
+std::size_t run_batch_jobs(std::vector<std::string> const& files,
+    unsigned n_workers, Load load, Run run, std::ostream& os = std::cout)
+{
+    n_workers = std::max(1u, n_workers);
+    std::size_t const max_loaded = 2 * std::size_t(n_workers);
+
+    struct job
+    {
+        std::string file;
+        json_logger record{false};
+        int n = 0;
+        std::vector<csr_graph::edge> edges;
+        bool loaded = false;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv_loaded;
+    // Jobs loaded and not started yet
+    std::size_t n_loaded = 0;
+    std::size_t n_failed = 0;
+
+    thread_pool pool(n_workers);
+    auto run_job = [&](std::shared_ptr<job> const& j) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --n_loaded;
+        }
+        cv_loaded.notify_one();
+        int status = 1;
+        {
+            json_logger::redirect redirect(j->record);
+            try
+            {
+                if (j->loaded)
+                    status = run(j->n, j->edges);
+            }
+            catch (std::exception const& e)
+            {
+                global_json_logger.add("error", std::string(e.what()));
+            }
+            global_json_logger.add("status", status);
+        }
+        // Free the graph before the next job comes
+        j->edges = {};
+        std::ostringstream line;
+        j->record.write(line);
+        std::lock_guard<std::mutex> lock(mutex);
+        n_failed += status != 0;
+        os << line.str() << std::flush;
+    };
+
+    std::thread loader([&] {
+        for (std::string const& file : files)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv_loaded.wait(lock, [&] { return n_loaded < max_loaded; });
+                ++n_loaded;
+            }
+            auto j = std::make_shared<job>();
+            j->file = file;
+            {
+                json_logger::redirect redirect(j->record);
+                global_json_logger.add("graph", file);
+                try
+                {
+                    j->loaded = load(file, j->n, j->edges);
+                }
+                catch (std::exception const& e)
+                {
+                    global_json_logger.add("error", std::string(e.what()));
+                }
+            }
+            pool.submit([j, &run_job](unsigned) { run_job(j); });
+        }
+    });
+    // Every job is submitted once the loader is done
+    loader.join();
+    pool.wait();
+    return n_failed;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "csr_graph.hpp"
+
+// The connected components and the biconnected components (blocks) of a
+// csr_graph, by Tarjan's algorithm. Every edge belongs to exactly one block,
+// and two blocks share at most one node, an articulation point. A bridge is
+// a block of its own.
+//
+// The depth first search keeps its own stack, so deep graphs (long paths)
+// cannot overflow the call stack.
+class block_decomposition
+{
+    // Edges of all blocks, grouped by block: block i is
+    // _edges[_block_start[i], _block_start[i + 1])
+    std::vector<csr_graph::edge> _edges;
+    std::vector<int> _block_start{0};
+
+    // Connected component of each node, and the first node of each
+    std::vector<int> _component;
+    std::vector<int> _component_root;
+
+    // DFS state: discovery time, low point, and the frames of the search
+    std::vector<int> _disc;
+    std::vector<int> _low;
+    struct frame
+    {
+        int u;
+        // The arc the search came in by, -1 at the root
+        int in_arc;
+        // Next arc out of u to look at
+        int next_arc;
+    };
+    std::vector<frame> _frames;
+    // Arcs whose block is not known yet
+    std::vector<int> _arc_stack;
+
+public:
+    block_decomposition() = default;
+
+    void run(csr_graph const& g)
+    {
+        int const n = g.n_nodes();
+        int const* targets = g.targets();
+        int const* reverses = g.reverses();
+
+        _edges.clear();
+        _block_start.assign(1, 0);
+        _component.assign(n, -1);
+        _component_root.clear();
+        _disc.assign(n, -1);
+        _low.assign(n, 0);
+        _frames.clear();
+        _arc_stack.clear();
+        int time = 0;
+
+        for (int root = 0; root < n; ++root)
+        {
+            if (_disc[root] != -1)
+                continue;
+            int component = static_cast<int>(_component_root.size());
+            _component_root.push_back(root);
+            _component[root] = component;
+            _disc[root] = _low[root] = time++;
+            _frames.push_back({root, -1, g.begin(root)});
+
+            while (!_frames.empty())
+            {
+                frame& f = _frames.back();
+                int u = f.u;
+                if (f.next_arc < g.end(u))
+                {
+                    int a = f.next_arc++;
+                    int v = targets[a];
+                    // Only the arc back to the parent is skipped, so that
+                    // parallel edges to the parent are back edges
+                    if (a == f.in_arc)
+                        continue;
+                    if (_disc[v] == -1)
+                    {
+                        _arc_stack.push_back(a);
+                        _component[v] = component;
+                        _disc[v] = _low[v] = time++;
+                        _frames.push_back({v, reverses[a], g.begin(v)});
+                    }
+                    else if (_disc[v] < _disc[u])
+                    {
+                        // A back edge, seen from its lower end
+                        _arc_stack.push_back(a);
+                        _low[u] = std::min(_low[u], _disc[v]);
+                    }
+                    continue;
+                }
+
+                // u is done. If nothing below u reaches above its parent,
+                // the arcs pushed since the parent-u arc form a block.
+                int in_arc = f.in_arc;
+                _frames.pop_back();
+                if (in_arc == -1)
+                    continue;
+                int p = targets[in_arc];
+                _low[p] = std::min(_low[p], _low[u]);
+                if (_low[u] >= _disc[p])
+                {
+                    int tree_arc = reverses[in_arc];
+                    int a;
+                    do
+                    {
+                        a = _arc_stack.back();
+                        _arc_stack.pop_back();
+                        _edges.push_back(
+                            {targets[reverses[a]], targets[a], g.capacity(a)});
+                    } while (a != tree_arc);
+                    _block_start.push_back(static_cast<int>(_edges.size()));
+                }
+            }
+        }
+    }
+
+    int n_blocks() const
+    {
+        return static_cast<int>(_block_start.size()) - 1;
+    }
+
+    // The edges of block i
+    csr_graph::edge const* block_begin(int i) const
+    {
+        return _edges.data() + _block_start[i];
+    }
+
+    csr_graph::edge const* block_end(int i) const
+    {
+        return _edges.data() + _block_start[i + 1];
+    }
+
+    int block_size(int i) const
+    {
+        return _block_start[i + 1] - _block_start[i];
+    }
+
+    int n_components() const
+    {
+        return static_cast<int>(_component_root.size());
+    }
+
+    int component(int u) const
+    {
+        return _component[u];
+    }
+
+    // The first node of component i
+    int component_root(int i) const
+    {
+        return _component_root[i];
+    }
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Minimum s-t cut by the Boykov-Kolmogorov algorithm on a csr_graph.
+// Two search trees grow from s and t until they touch, the path found is
+// augmented, and the nodes cut off from their tree by saturated arcs
+// (orphans) are re-adopted or freed. The trees are reused from one path to
+// the next instead of searching from scratch, which pays off on graphs with
+// short augmenting paths (grids, sparse graphs with local structure).
+// Orphans are adopted by the closest valid parent, using the timestamp and
+// distance marks of the original paper.
+//
+// Same interface as push_relabel; the workspace is kept between runs.
+class boykov_kolmogorov
+{
+public:
+    using flow_type = std::int64_t;
+
+private:
+    enum : char
+    {
+        FREE = 0,
+        SOURCE = 1,
+        SINK = 2
+    };
+
+    // Parent arc values that are not arcs
+    static constexpr int TERMINAL = -1;
+    static constexpr int ORPHAN = -2;
+
+    // Residual capacity of each arc
+    std::vector<int> _res;
+    std::vector<char> _tree;
+    // In the source tree, the arc parent->u; in the sink tree, the arc
+    // u->parent. Both have residual capacity.
+    std::vector<int> _parent;
+    // Distance to the terminal, valid if _ts[u] == _time
+    std::vector<int> _dist;
+    std::vector<unsigned> _ts;
+    unsigned _time = 0;
+
+    std::deque<int> _active;
+    std::vector<char> _is_active;
+    std::deque<int> _orphans;
+    std::vector<int> _path;
+
+    std::vector<std::uint64_t> _source_side;
+    flow_type _flow = 0;
+    std::size_t _n_paths = 0;
+
+    csr_graph const* _g = nullptr;
+
+    void make_active(int u)
+    {
+        if (!_is_active[u])
+        {
+            _is_active[u] = 1;
+            _active.push_back(u);
+        }
+    }
+
+    // The parent of u in its tree
+    int parent_node(int u) const
+    {
+        int a = _parent[u];
+        return _tree[u] == SOURCE ? _g->target(_g->reverse(a)) : _g->target(a);
+    }
+
+    // Augment along s ~> x -> y ~> t, where a is the arc x->y
+    void augment(int a)
+    {
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+
+        int x = targets[reverses[a]];
+        int y = targets[a];
+
+        int delta = _res[a];
+        for (int u = x; _parent[u] != TERMINAL; u = parent_node(u))
+        {
+            delta = std::min(delta, _res[_parent[u]]);
+        }
+        for (int u = y; _parent[u] != TERMINAL; u = parent_node(u))
+        {
+            delta = std::min(delta, _res[_parent[u]]);
+        }
+
+        _res[a] -= delta;
+        _res[reverses[a]] += delta;
+        for (int u = x; _parent[u] != TERMINAL;)
+        {
+            int b = _parent[u];
+            int p = parent_node(u);
+            _res[b] -= delta;
+            _res[reverses[b]] += delta;
+            if (_res[b] == 0)
+            {
+                _parent[u] = ORPHAN;
+                _orphans.push_back(u);
+            }
+            u = p;
+        }
+        for (int u = y; _parent[u] != TERMINAL;)
+        {
+            int b = _parent[u];
+            int p = parent_node(u);
+            _res[b] -= delta;
+            _res[reverses[b]] += delta;
+            if (_res[b] == 0)
+            {
+                _parent[u] = ORPHAN;
+                _orphans.push_back(u);
+            }
+            u = p;
+        }
+
+        _flow += delta;
+        ++_n_paths;
+    }
+
+    // Distance from u to its terminal, or -1 if the way up meets an orphan.
+    // Marks the nodes on the way with their distance.
+    int origin_distance(int u)
+    {
+        int d = 0;
+        int v = u;
+        while (true)
+        {
+            if (_ts[v] == _time)
+            {
+                d += _dist[v];
+                break;
+            }
+            int a = _parent[v];
+            if (a == TERMINAL)
+            {
+                _ts[v] = _time;
+                _dist[v] = 0;
+                break;
+            }
+            if (a == ORPHAN)
+                return -1;
+            ++d;
+            v = parent_node(v);
+        }
+
+        // Mark the path with distances
+        for (int w = u; _ts[w] != _time; w = parent_node(w))
+        {
+            _ts[w] = _time;
+            _dist[w] = d--;
+        }
+        return _dist[u];
+    }
+
+    void adopt(int u)
+    {
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+        char tree = _tree[u];
+
+        // Find the closest parent in the same tree that still reaches the
+        // terminal through arcs with residual capacity
+        int best_arc = ORPHAN;
+        int best_dist = 0;
+        for (int a = _g->begin(u); a < _g->end(u); ++a)
+        {
+            int v = targets[a];
+            if (_tree[v] != tree)
+                continue;
+            // The arc between v and u, in the direction of the tree
+            int b = tree == SOURCE ? reverses[a] : a;
+            if (_res[b] == 0)
+                continue;
+            int d = origin_distance(v);
+            if (d >= 0 && (best_arc == ORPHAN || d < best_dist))
+            {
+                best_arc = b;
+                best_dist = d;
+            }
+        }
+
+        if (best_arc != ORPHAN)
+        {
+            _parent[u] = best_arc;
+            _ts[u] = _time;
+            _dist[u] = best_dist + 1;
+            return;
+        }
+
+        // No parent: u becomes free. Its neighbors that could reach it
+        // become active again, and its children orphans.
+        for (int a = _g->begin(u); a < _g->end(u); ++a)
+        {
+            int v = targets[a];
+            if (_tree[v] != tree)
+                continue;
+            int b = tree == SOURCE ? reverses[a] : a;
+            if (_res[b] > 0)
+                make_active(v);
+            if (_parent[v] != TERMINAL && _parent[v] != ORPHAN &&
+                parent_node(v) == u)
+            {
+                _parent[v] = ORPHAN;
+                _orphans.push_back(v);
+            }
+        }
+        _tree[u] = FREE;
+    }
+
+    // Grow the tree of u by one level. Returns an arc x->y joining the two
+    // trees (x in the source tree), or -1.
+    int grow(int u)
+    {
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+
+        for (int a = _g->begin(u); a < _g->end(u); ++a)
+        {
+            int v = targets[a];
+            // The arc from the source side to the sink side of u-v
+            int b = _tree[u] == SOURCE ? a : reverses[a];
+            if (_res[b] == 0)
+                continue;
+
+            if (_tree[v] == FREE)
+            {
+                _tree[v] = _tree[u];
+                _parent[v] = b;
+                _ts[v] = _ts[u];
+                _dist[v] = _dist[u] + 1;
+                make_active(v);
+            }
+            else if (_tree[v] != _tree[u])
+            {
+                return b;
+            }
+        }
+        return -1;
+    }
+
+public:
+    boykov_kolmogorov() = default;
+
+    // Compute a maximum s-t flow value and a minimum s-t cut of g
+    void run(csr_graph const& g, int s, int t)
+    {
+        _g = &g;
+        int n = g.n_nodes();
+        _res.assign(g.capacities(), g.capacities() + g.n_arcs());
+        _tree.assign(n, FREE);
+        _parent.assign(n, ORPHAN);
+        _dist.assign(n, 0);
+        _ts.assign(n, 0);
+        _time = 0;
+        _is_active.assign(n, 0);
+        _active.clear();
+        _orphans.clear();
+        _flow = 0;
+
+        _tree[s] = SOURCE;
+        _tree[t] = SINK;
+        _parent[s] = TERMINAL;
+        _parent[t] = TERMINAL;
+        make_active(s);
+        make_active(t);
+
+        while (!_active.empty())
+        {
+            int u = _active.front();
+            if (_tree[u] == FREE)
+            {
+                _active.pop_front();
+                _is_active[u] = 0;
+                continue;
+            }
+
+            int a = grow(u);
+            if (a == -1)
+            {
+                // u cannot grow its tree any further
+                _active.pop_front();
+                _is_active[u] = 0;
+                continue;
+            }
+
+            // Keep u active: it may have more arcs to the other tree
+            ++_time;
+            augment(a);
+            while (!_orphans.empty())
+            {
+                int o = _orphans.front();
+                _orphans.pop_front();
+                adopt(o);
+            }
+        }
+
+        // The source tree is the set of nodes reachable from s
+        _source_side.assign((n + 63) / 64, 0);
+        for (int u = 0; u < n; ++u)
+        {
+            if (_tree[u] == SOURCE)
+                _source_side[u / 64] |= std::uint64_t(1) << (u % 64);
+        }
+    }
+
+    flow_type flow_value() const
+    {
+        return _flow;
+    }
+
+    // True if u is on the source side of the minimum cut
+    bool min_cut(int u) const
+    {
+        return (_source_side[u / 64] >> (u % 64)) & 1;
+    }
+
+    // The source side of the minimum cut as a bitset: bit u % 64 of word u / 64
+    std::vector<std::uint64_t> const& source_side() const
+    {
+        return _source_side;
+    }
+
+    std::size_t n_paths() const
+    {
+        return _n_paths;
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include "csr_graph.hpp"
+
+// The quotient of a graph under a node labelling: nodes with the same label
+// are merged into one node, loops and edges of weight 0 are dropped, and
+// parallel edges are merged into a single edge carrying the sum of their
+// weights.
+//
+// The contracted graph and all the scratch arrays are kept from one build to
+// the next, so after the first few builds no memory is allocated.
+class contracted_graph
+{
+    csr_graph _graph;
+    std::vector<csr_graph::edge> _edges;
+
+    // Graph nodes grouped by label (a counting sort)
+    std::vector<int> _label_start;
+    std::vector<int> _by_label;
+    std::vector<int> _label_fill;
+
+    // For the label being scanned, the index in _edges of the edge to each
+    // other label. _edge_to[b] is valid if _edge_owner[b] is the label being
+    // scanned.
+    std::vector<int> _edge_owner;
+    std::vector<int> _edge_to;
+
+public:
+    contracted_graph() = default;
+
+    contracted_graph(contracted_graph const&) = delete;
+    contracted_graph& operator=(contracted_graph const&) = delete;
+
+    // Contract g. label is indexed by CSR node and takes values in
+    // [0, n_labels). Contracted node i is label i, and edges are added in a
+    // deterministic order.
+    void build(csr_graph const& g, std::vector<int> const& label, int n_labels)
+    {
+        contract(
+            g, g.capacities(), g.n_nodes(), [](int i) { return i; }, label,
+            n_labels);
+    }
+
+    // Contract the subgraph of g on nodes, with the arc capacities capacity
+    // instead of those of g. Arcs of capacity 0 are dropped, and every other
+    // arc out of nodes must lead to one of them; label only needs to be set
+    // on nodes.
+    void build(csr_graph const& g, int const* capacity,
+        std::vector<int> const& nodes, std::vector<int> const& label,
+        int n_labels)
+    {
+        contract(
+            g, capacity, static_cast<int>(nodes.size()),
+            [&nodes](int i) { return nodes[i]; }, label, n_labels);
+    }
+
+    csr_graph const& graph() const
+    {
+        return _graph;
+    }
+
+private:
+    // Contract the nodes node(0), ..., node(n_nodes - 1) of g
+    template <typename NodeAt>
+    void contract(csr_graph const& g, int const* capacity, int n_nodes,
+        NodeAt node, std::vector<int> const& label, int n_labels)
+    {
+        // Group the graph nodes by label
+        _label_start.assign(n_labels + 1, 0);
+        for (int i = 0; i < n_nodes; ++i)
+        {
+            ++_label_start[label[node(i)] + 1];
+        }
+        for (int i = 0; i < n_labels; ++i)
+        {
+            _label_start[i + 1] += _label_start[i];
+        }
+        _by_label.resize(n_nodes);
+        _label_fill.assign(_label_start.begin(), _label_start.end() - 1);
+        for (int i = 0; i < n_nodes; ++i)
+        {
+            int u = node(i);
+            _by_label[_label_fill[label[u]]++] = u;
+        }
+
+        // Scan the arcs out of each label. Each edge is added from the side
+        // with the smaller label, merged with the previous edge to the same
+        // label if there is one.
+        _edges.clear();
+        _edge_owner.assign(n_labels, -1);
+        _edge_to.resize(n_labels);
+        for (int a = 0; a < n_labels; ++a)
+        {
+            for (int i = _label_start[a]; i < _label_start[a + 1]; ++i)
+            {
+                int u = _by_label[i];
+                for (int arc = g.begin(u); arc < g.end(u); ++arc)
+                {
+                    if (capacity[arc] == 0)
+                        continue;
+                    int b = label[g.target(arc)];
+                    if (b <= a)
+                        continue;
+
+                    if (_edge_owner[b] == a)
+                    {
+                        _edges[_edge_to[b]].weight += capacity[arc];
+                    }
+                    else
+                    {
+                        _edge_owner[b] = a;
+                        _edge_to[b] = static_cast<int>(_edges.size());
+                        _edges.push_back({a, b, capacity[arc]});
+                    }
+                }
+            }
+        }
+
+        _graph.build(n_labels, _edges);
+    }
+};
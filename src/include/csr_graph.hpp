@@ -0,0 +1,240 @@
+#pragma once
+
+#include <lemon/list_graph.h>
+#include <lemon/static_graph.h>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// An undirected graph in compressed sparse row layout. Its arcs are fixed
+// once built; only their capacities can change. Nodes are 0..n_nodes()-1.
+// Every undirected edge {u, v} is stored as two arcs u->v and v->u, which
+// are each other's reverse. The arcs out of u are [begin(u), end(u)), and
+// targets, reverse arcs and capacities are separate contiguous arrays
+// (structure of arrays), so that scanning the neighbors of a node touches a
+// few cache lines instead of chasing list pointers.
+class csr_graph
+{
+public:
+    struct edge
+    {
+        int u;
+        int v;
+        int weight;
+    };
+
+private:
+    int _n_nodes = 0;
+    std::vector<int> _offsets{0};
+    std::vector<int> _targets;
+    std::vector<int> _reverse;
+    std::vector<int> _capacities;
+    std::vector<int> _fill;
+    std::uint64_t _stamp = 0;
+
+    // A number that no other build has used
+    static std::uint64_t next_stamp()
+    {
+        static std::atomic<std::uint64_t> counter{0};
+        return ++counter;
+    }
+
+public:
+    csr_graph() = default;
+
+    // Build from a list of undirected edges. Loops are dropped. The storage
+    // of a previous build is reused.
+    void build(int n_nodes, std::vector<edge> const& edges)
+    {
+        _n_nodes = n_nodes;
+        _stamp = next_stamp();
+
+        _offsets.assign(n_nodes + 1, 0);
+        for (edge const& e : edges)
+        {
+            if (e.u == e.v)
+                continue;
+            ++_offsets[e.u + 1];
+            ++_offsets[e.v + 1];
+        }
+        for (int i = 0; i < n_nodes; ++i)
+        {
+            _offsets[i + 1] += _offsets[i];
+        }
+
+        int n_arcs = _offsets[n_nodes];
+        _targets.resize(n_arcs);
+        _reverse.resize(n_arcs);
+        _capacities.resize(n_arcs);
+
+        // Next free arc slot of each node
+        _fill.assign(_offsets.begin(), _offsets.end() - 1);
+        for (edge const& e : edges)
+        {
+            if (e.u == e.v)
+                continue;
+            int a = _fill[e.u]++;
+            int b = _fill[e.v]++;
+            _targets[a] = e.v;
+            _targets[b] = e.u;
+            _reverse[a] = b;
+            _reverse[b] = a;
+            _capacities[a] = e.weight;
+            _capacities[b] = e.weight;
+        }
+    }
+
+    // Build from a lemon graph. CSR node i is nodes[i]; nodes are ordered by
+    // increasing id, so that i == id when the ids are contiguous.
+    void build(lemon::ListGraph const& g,
+        lemon::ListGraph::EdgeMap<int> const& weights,
+        std::vector<lemon::ListGraph::Node>& nodes)
+    {
+        nodes.clear();
+        std::vector<int> index(g.maxNodeId() + 1, -1);
+        for (int i = 0; i <= g.maxNodeId(); ++i)
+        {
+            if (g.valid(g.nodeFromId(i)))
+            {
+                index[i] = static_cast<int>(nodes.size());
+                nodes.push_back(g.nodeFromId(i));
+            }
+        }
+
+        std::vector<edge> edges;
+        for (lemon::ListGraph::EdgeIt e(g); e != lemon::INVALID; ++e)
+        {
+            edges.push_back(
+                {index[g.id(g.u(e))], index[g.id(g.v(e))], weights[e]});
+        }
+
+        build(static_cast<int>(nodes.size()), edges);
+    }
+
+    int n_nodes() const
+    {
+        return _n_nodes;
+    }
+
+    // Identifies the contents of the graph: it changes on every build and
+    // capacity change, so workspaces can tell whether they still match the
+    // graph
+    std::uint64_t stamp() const
+    {
+        return _stamp;
+    }
+
+    int n_arcs() const
+    {
+        return _offsets[_n_nodes];
+    }
+
+    int begin(int u) const
+    {
+        return _offsets[u];
+    }
+
+    int end(int u) const
+    {
+        return _offsets[u + 1];
+    }
+
+    int degree(int u) const
+    {
+        return _offsets[u + 1] - _offsets[u];
+    }
+
+    int target(int a) const
+    {
+        return _targets[a];
+    }
+
+    int reverse(int a) const
+    {
+        return _reverse[a];
+    }
+
+    int capacity(int a) const
+    {
+        return _capacities[a];
+    }
+
+    // Set the capacity of the edge of arc a, in both directions. The graph
+    // gets a new stamp.
+    void set_capacity(int a, int capacity)
+    {
+        _capacities[a] = capacity;
+        _capacities[_reverse[a]] = capacity;
+        _stamp = next_stamp();
+    }
+
+    int const* offsets() const
+    {
+        return _offsets.data();
+    }
+
+    int const* targets() const
+    {
+        return _targets.data();
+    }
+
+    int const* reverses() const
+    {
+        return _reverse.data();
+    }
+
+    int const* capacities() const
+    {
+        return _capacities.data();
+    }
+};
+
+// A lemon::StaticDigraph with the nodes and arcs of a csr_graph: node i and
+// arc a of the digraph are node i and arc a of the CSR graph. This lets lemon
+// algorithms such as Preflow run on the contiguous layout.
+// lemon maps register with their graph, so threads need their own copy.
+class csr_digraph
+{
+    lemon::StaticDigraph _digraph;
+    lemon::StaticDigraph::ArcMap<int> _capacity;
+
+public:
+    explicit csr_digraph(csr_graph const& g)
+      : _capacity(_digraph)
+    {
+        std::vector<std::pair<int, int>> arcs;
+        arcs.reserve(g.n_arcs());
+        for (int u = 0; u < g.n_nodes(); ++u)
+        {
+            for (int a = g.begin(u); a < g.end(u); ++a)
+            {
+                arcs.emplace_back(u, g.target(a));
+            }
+        }
+        _digraph.build(g.n_nodes(), arcs.begin(), arcs.end());
+
+        for (int a = 0; a < g.n_arcs(); ++a)
+        {
+            _capacity[lemon::StaticDigraph::arc(a)] = g.capacity(a);
+        }
+    }
+
+    csr_digraph(csr_digraph const&) = delete;
+    csr_digraph& operator=(csr_digraph const&) = delete;
+
+    lemon::StaticDigraph const& digraph() const
+    {
+        return _digraph;
+    }
+
+    lemon::StaticDigraph::ArcMap<int> const& capacity() const
+    {
+        return _capacity;
+    }
+
+    static lemon::StaticDigraph::Node node(int i)
+    {
+        return lemon::StaticDigraph::node(i);
+    }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "csr_graph.hpp"
+
+// The hierarchy of min k-cuts of a Gomory-Hu tree, as a single-linkage
+// dendrogram. The tree edges are merged heaviest first with a union-find.
+// Cutting the k-1 lightest edges leaves the components formed by all but
+// the last k-1 merges, so one pass over the merges gives the components
+// for every k.
+//
+// Clusters are numbered as in single-linkage clustering: the nodes are
+// clusters 0..n-1, and merge i creates cluster n + i.
+class cut_dendrogram
+{
+public:
+    struct merge
+    {
+        // The two clusters merged
+        int a;
+        int b;
+        // The flow of the tree edge, the cut between the two clusters
+        int flow;
+        // Number of nodes of the new cluster
+        int size;
+    };
+
+private:
+    int _n_nodes = 0;
+    std::vector<merge> _merges;
+    // The tree edge of each merge, by node
+    std::vector<std::pair<int, int>> _edges;
+
+    static int find(std::vector<int>& root, int u)
+    {
+        while (root[u] != u)
+        {
+            root[u] = root[root[u]];
+            u = root[u];
+        }
+        return u;
+    }
+
+public:
+    cut_dendrogram() = default;
+
+    // Build from the edges (u, v, flow) of a tree, or a forest, on nodes
+    // 0..n_nodes-1. Edges of equal flow merge in the order given.
+    void build(int n_nodes, std::vector<csr_graph::edge> const& edges)
+    {
+        _n_nodes = n_nodes;
+        _merges.clear();
+        _edges.clear();
+
+        std::vector<int> order(edges.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return edges[a].weight > edges[b].weight;
+        });
+
+        std::vector<int> root(n_nodes);
+        std::iota(root.begin(), root.end(), 0);
+        // The cluster and size of each union-find root
+        std::vector<int> cluster = root;
+        std::vector<int> size(n_nodes, 1);
+        for (int i : order)
+        {
+            int a = find(root, edges[i].u);
+            int b = find(root, edges[i].v);
+            if (a == b)
+                continue;
+            int merged = size[a] + size[b];
+            _merges.push_back(
+                {cluster[a], cluster[b], edges[i].weight, merged});
+            _edges.emplace_back(edges[i].u, edges[i].v);
+            if (size[a] < size[b])
+                std::swap(a, b);
+            root[b] = a;
+            size[a] = merged;
+            cluster[a] = n_nodes + static_cast<int>(_merges.size()) - 1;
+        }
+    }
+
+    int n_nodes() const
+    {
+        return _n_nodes;
+    }
+
+    // The merges, heaviest first
+    std::vector<merge> const& merges() const
+    {
+        return _merges;
+    }
+
+    // The fewest components any k-cut can leave: those of the whole tree
+    int min_components() const
+    {
+        return _n_nodes - static_cast<int>(_merges.size());
+    }
+
+    // The component of every node for each k of ks, in one pass over the
+    // merges: labels[u * ks.size() + j] is the component of node u for
+    // ks[j]. Components are numbered from 1, by their smallest node, as in
+    // k_min_cut::min_k_cut_map. A k below min_components() gives the
+    // components of the whole tree, and a k above n_nodes() single nodes.
+    void labels(std::vector<unsigned int> const& ks,
+        std::vector<unsigned int>& labels) const
+    {
+        std::size_t const n_ks = ks.size();
+        labels.assign(std::size_t(_n_nodes) * n_ks, 0);
+
+        // Largest k first, so that the merges only accumulate
+        std::vector<std::size_t> order(n_ks);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(),
+            [&](std::size_t a, std::size_t b) { return ks[a] > ks[b]; });
+
+        std::vector<int> root(_n_nodes);
+        std::iota(root.begin(), root.end(), 0);
+        std::vector<unsigned int> color(_n_nodes);
+        std::size_t n_merged = 0;
+        for (std::size_t j : order)
+        {
+            // k components are left by n - k merges
+            std::size_t n_merges = std::min(_merges.size(),
+                std::size_t(std::max(0ll, (long long) _n_nodes - ks[j])));
+            for (; n_merged < n_merges; ++n_merged)
+            {
+                int a = find(root, _edges[n_merged].first);
+                int b = find(root, _edges[n_merged].second);
+                // The smaller node stays the root, so that roots are the
+                // smallest nodes of their components
+                root[std::max(a, b)] = std::min(a, b);
+            }
+
+            unsigned int n_colors = 0;
+            for (int u = 0; u < _n_nodes; ++u)
+            {
+                int r = find(root, u);
+                if (r == u)
+                    color[u] = ++n_colors;
+                labels[std::size_t(u) * n_ks + j] = color[r];
+            }
+        }
+    }
+};
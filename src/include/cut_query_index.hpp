@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Answers "min cut between s and t" on a Gomory-Hu tree in constant time.
+// The answer is the smallest flow on the tree path from s to t.
+//
+// The tree edges are added by decreasing flow, as in Kruskal's algorithm,
+// and every merge of two components appends the node list of one to the
+// other. Each component is then a contiguous run of the final node order,
+// and the flow of the merge sits in the gap between the two runs. So s and
+// t were first joined by the smallest gap between their positions, and a
+// query is a range minimum over the gaps, read from a sparse table.
+// Nodes of different trees of a forest have a gap of 0 between them.
+class cut_query_index
+{
+    // Position of each tree node in the node order
+    std::vector<int> _pos;
+    int _n_gaps = 0;
+    // Level j of the table holds, at i, the smallest of gaps [i, i + 2^j)
+    std::vector<int> _table;
+
+    static int floor_log2(unsigned x)
+    {
+#if defined(__GNUC__)
+        return 31 - __builtin_clz(x);
+#else
+        int l = 0;
+        while (x >>= 1)
+            ++l;
+        return l;
+#endif
+    }
+
+    int range_min(int l, int r) const
+    {
+        // Gaps [l, r), r > l
+        int j = floor_log2(unsigned(r - l));
+        int const* level = _table.data() + std::size_t(j) * _n_gaps;
+        return std::min(level[l], level[r - (1 << j)]);
+    }
+
+public:
+    cut_query_index() = default;
+
+    // Build from the edges (u, v, flow) of a tree, or a forest, on nodes
+    // 0..n_nodes-1
+    void build(int n_nodes, std::vector<csr_graph::edge> const& edges)
+    {
+        std::vector<int> order(edges.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return edges[a].weight > edges[b].weight;
+        });
+
+        // Union-find whose components are node lists: the first and last
+        // node of a component (at its root), the node after each node, and
+        // the gap after it
+        std::vector<int> root(n_nodes);
+        std::iota(root.begin(), root.end(), 0);
+        std::vector<int> size(n_nodes, 1);
+        std::vector<int> head(n_nodes);
+        std::iota(head.begin(), head.end(), 0);
+        std::vector<int> tail = head;
+        std::vector<int> next(n_nodes, -1);
+        std::vector<int> gap(n_nodes, 0);
+        auto find = [&](int u) {
+            while (root[u] != u)
+            {
+                root[u] = root[root[u]];
+                u = root[u];
+            }
+            return u;
+        };
+
+        for (int i : order)
+        {
+            int a = find(edges[i].u);
+            int b = find(edges[i].v);
+            if (a == b)
+                continue;
+            // The list of a, then the list of b
+            next[tail[a]] = head[b];
+            gap[tail[a]] = edges[i].weight;
+            tail[a] = tail[b];
+            if (size[a] < size[b])
+            {
+                std::swap(a, b);
+                head[a] = head[b];
+                tail[a] = tail[b];
+            }
+            root[b] = a;
+            size[a] += size[b];
+        }
+
+        // Lay out the components one after the other
+        _pos.assign(n_nodes, 0);
+        _n_gaps = std::max(0, n_nodes - 1);
+        _table.assign(_n_gaps, 0);
+        int p = 0;
+        for (int u = 0; u < n_nodes; ++u)
+        {
+            if (find(u) != u)
+                continue;
+            for (int v = head[u]; v != -1; v = next[v])
+            {
+                _pos[v] = p;
+                if (p < _n_gaps)
+                    _table[p] = next[v] != -1 ? gap[v] : 0;
+                ++p;
+            }
+        }
+
+        // The other levels of the sparse table
+        int n_levels = _n_gaps > 0 ? floor_log2(unsigned(_n_gaps)) + 1 : 0;
+        _table.resize(std::size_t(n_levels) * _n_gaps);
+        for (int j = 1; j < n_levels; ++j)
+        {
+            int const* prev = _table.data() + std::size_t(j - 1) * _n_gaps;
+            int* level = _table.data() + std::size_t(j) * _n_gaps;
+            int half = 1 << (j - 1);
+            for (int i = 0; i + 2 * half <= _n_gaps; ++i)
+            {
+                level[i] = std::min(prev[i], prev[i + half]);
+            }
+        }
+    }
+
+    // Build from a tree in parent form (parent -1 at roots), where flow[i]
+    // is the flow of the edge from i to its parent
+    void build(std::vector<int> const& parent, std::vector<int> const& flow)
+    {
+        std::vector<csr_graph::edge> edges;
+        for (std::size_t i = 0; i < parent.size(); ++i)
+        {
+            if (parent[i] != -1)
+                edges.push_back({int(i), parent[i], flow[i]});
+        }
+        build(static_cast<int>(parent.size()), edges);
+    }
+
+    int n_nodes() const
+    {
+        return static_cast<int>(_pos.size());
+    }
+
+    // The min cut between tree nodes s and t, or the largest int if s == t
+    int min_cut(int s, int t) const
+    {
+        int l = _pos[s];
+        int r = _pos[t];
+        if (l == r)
+            return std::numeric_limits<int>::max();
+        if (l > r)
+            std::swap(l, r);
+        return range_min(l, r);
+    }
+
+    // values[i] = min_cut(s[i], t[i]) for i < count. The positions are
+    // looked up for the whole batch first, so the table lookups run as one
+    // branch-light pass.
+    void min_cuts(std::size_t count, int const* s, int const* t,
+        int* values) const
+    {
+        constexpr std::size_t block = 1024;
+        int l[block];
+        int r[block];
+        for (std::size_t first = 0; first < count; first += block)
+        {
+            std::size_t n = std::min(block, count - first);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                int a = _pos[s[first + i]];
+                int b = _pos[t[first + i]];
+                l[i] = std::min(a, b);
+                r[i] = std::max(a, b);
+            }
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                values[first + i] = l[i] == r[i]
+                    ? std::numeric_limits<int>::max()
+                    : range_min(l[i], r[i]);
+            }
+        }
+    }
+};
@@ -1,70 +1,111 @@
 #pragma once
 
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
+#include "mapped_file.hpp"
+#include "reader_util.hpp"
 
-    template <typename Graph, typename ArcMap>
-    std::istream& readDimacsGraph(
-        Graph& graph, ArcMap& arc_map, std::istream& is = std::cin)
+// Parse the DIMACS text [first, last) into its number of nodes and its
+// edges, with 0-based nodes. Returns false on invalid data.
+// The arcs are parsed on n_threads threads (see parse_entries).
+inline bool parseDimacs(char const* first, char const* last, int& n_nodes,
+    std::vector<csr_graph::edge>& edges, unsigned n_threads = 1)
 {
-    graph.clear();
-
-    std::string line;
+    text_scanner in(first, last);
 
     // Skip comments
-    while (getline(is, line))
-    {
-        if (line[0] != 'c')
-        {
-            break;
-        }
-    }
+    in.skip_lines('c');
 
     // Read header
-    // Should start with "p ps"
-    if (line.substr(0, 4) != "p sp")
+    // Should start with "p sp"
+    if (!in.starts_with("p sp"))
     {
         std::cerr << "Invalid or unsupported Dimacs file" << std::endl;
-        return is;
+        return false;
     }
+    in.advance(4);
 
     int n, m;
-    if (!(std::istringstream(line.substr(4)) >> n >> m))
+    if (!in.read(n) || !in.read(m) || n < 0 || m < 0)
     {
         std::cerr << "Error reading Dimacs file" << std::endl;
-        return is;
+        return false;
     }
+    in.skip_line();
+
+    // Read edges
+    auto parse_arc = [n](text_scanner& line, csr_graph::edge& e) {
+        if (line.peek() != 'a')
+            return false;
+        line.advance();
 
-    // Add nodes
-    for (int i = 0; i < n; ++i)
+        int u, v, w;
+        if (!line.read(u) || !line.read(v) || !line.read(w) || u < 1 ||
+            u > n || v < 1 || v > n)
+            return false;
+
+        e = {u - 1, v - 1, w};
+        return true;
+    };
+    if (!parse_entries(
+            in.position(), last, m, 'c', parse_arc, edges, n_threads))
     {
-        graph.addNode();
+        std::cerr << "Invalid Dimacs data" << std::endl;
+        return false;
     }
 
-    // Add edges
-    for (int i = 0; i < m; ++i)
+    n_nodes = n;
+    return true;
+}
+
+// Read the number of nodes and the edges of a DIMACS file, which is
+// memory-mapped and parsed in place on n_threads threads. Returns false if
+// the file cannot be read or is invalid.
+inline bool readDimacsEdges(std::string const& path, int& n_nodes,
+    std::vector<csr_graph::edge>& edges, unsigned n_threads = 1)
+{
+    mapped_file file;
+    if (!file.open(path))
     {
-        if (!getline(is, line) || line[0] != 'a')
-        {
-            std::cerr << "Invalid Dimacs data" << std::endl;
-            return is;
-        }
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    return parseDimacs(file.begin(), file.end(), n_nodes, edges, n_threads);
+}
 
-        std::istringstream line_is(line.substr(1));
+// Read a DIMACS graph from a file (see readDimacsEdges)
+template <typename Graph, typename ArcMap>
+bool readDimacsFile(Graph& graph, ArcMap& arc_map, std::string const& path,
+    unsigned n_threads = 1)
+{
+    graph.clear();
 
-        int u, v, w;
+    int n;
+    std::vector<csr_graph::edge> edges;
+    if (!readDimacsEdges(path, n, edges, n_threads))
+        return false;
 
-        if (!(line_is >> u >> v >> w))
-        {
-            std::cerr << "Invalid Dimacs data" << std::endl;
-            return is;
-        }
+    fill_graph(graph, arc_map, n, edges);
+    return true;
+}
 
-        auto e =
-            graph.addEdge(graph.nodeFromId(u - 1), graph.nodeFromId(v - 1));
+template <typename Graph, typename ArcMap>
+std::istream& readDimacsGraph(
+    Graph& graph, ArcMap& arc_map, std::istream& is = std::cin)
+{
+    graph.clear();
 
-        arc_map[e] = w;
+    // Read the rest of the stream at once, and parse it in place
+    std::string text(
+        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>{});
+
+    int n;
+    std::vector<csr_graph::edge> edges;
+    if (parseDimacs(text.data(), text.data() + text.size(), n, edges))
+    {
+        fill_graph(graph, arc_map, n, edges);
     }
 
     return is;
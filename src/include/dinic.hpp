@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Minimum s-t cut by Dinic's algorithm on a csr_graph: BFS levels from s,
+// then a blocking flow along level-increasing arcs, until t is unreachable.
+// The blocking flow search is iterative, so deep level graphs cannot
+// overflow the stack.
+//
+// Same interface as push_relabel; the workspace is kept between runs.
+class dinic
+{
+public:
+    using flow_type = std::int64_t;
+
+private:
+    // Residual capacity of each arc
+    std::vector<int> _res;
+    std::vector<int> _level;
+    // Next arc to try in the blocking flow search
+    std::vector<int> _current;
+    std::vector<int> _queue;
+    // Arcs of the path being searched
+    std::vector<int> _path;
+
+    std::vector<std::uint64_t> _source_side;
+    flow_type _flow = 0;
+    std::size_t _n_phases = 0;
+
+    // Level every node reachable from s. Returns true if t is reachable.
+    bool bfs(csr_graph const& g, int s, int t)
+    {
+        int const* targets = g.targets();
+        std::fill(_level.begin(), _level.end(), -1);
+        _level[s] = 0;
+        _queue.clear();
+        _queue.push_back(s);
+        for (std::size_t head = 0; head < _queue.size(); ++head)
+        {
+            int u = _queue[head];
+            for (int a = g.begin(u); a < g.end(u); ++a)
+            {
+                int v = targets[a];
+                if (_res[a] > 0 && _level[v] < 0)
+                {
+                    _level[v] = _level[u] + 1;
+                    _queue.push_back(v);
+                }
+            }
+        }
+        return _level[t] >= 0;
+    }
+
+    void blocking_flow(csr_graph const& g, int s, int t)
+    {
+        int const* targets = g.targets();
+        int const* reverses = g.reverses();
+
+        for (int u = 0; u < g.n_nodes(); ++u)
+        {
+            _current[u] = g.begin(u);
+        }
+
+        _path.clear();
+        int u = s;
+        while (true)
+        {
+            if (u == t)
+            {
+                int delta = _res[_path[0]];
+                for (int a : _path)
+                {
+                    delta = std::min(delta, _res[a]);
+                }
+                // Augment, and retreat to the tail of the first saturated arc
+                std::size_t first_saturated = _path.size();
+                for (std::size_t i = 0; i < _path.size(); ++i)
+                {
+                    int a = _path[i];
+                    _res[a] -= delta;
+                    _res[reverses[a]] += delta;
+                    if (_res[a] == 0 && first_saturated == _path.size())
+                        first_saturated = i;
+                }
+                _flow += delta;
+                _path.resize(first_saturated);
+                u = _path.empty() ? s : targets[_path.back()];
+                continue;
+            }
+
+            // Advance along an admissible arc
+            int& a = _current[u];
+            int end = g.end(u);
+            while (a < end &&
+                (_res[a] == 0 || _level[targets[a]] != _level[u] + 1))
+            {
+                ++a;
+            }
+            if (a < end)
+            {
+                _path.push_back(a);
+                u = targets[a];
+                continue;
+            }
+
+            // Dead end: remove u from the level graph and retreat
+            _level[u] = -1;
+            if (u == s)
+                return;
+            int back = _path.back();
+            _path.pop_back();
+            u = targets[reverses[back]];
+            ++_current[u];
+        }
+    }
+
+public:
+    dinic() = default;
+
+    // Compute a maximum s-t flow value and a minimum s-t cut of g
+    void run(csr_graph const& g, int s, int t)
+    {
+        int n = g.n_nodes();
+        _res.assign(g.capacities(), g.capacities() + g.n_arcs());
+        _level.resize(n);
+        _current.resize(n);
+        _flow = 0;
+
+        while (bfs(g, s, t))
+        {
+            ++_n_phases;
+            blocking_flow(g, s, t);
+        }
+
+        // The last BFS has reached exactly the source side of the cut
+        _source_side.assign((n + 63) / 64, 0);
+        for (int u : _queue)
+        {
+            _source_side[u / 64] |= std::uint64_t(1) << (u % 64);
+        }
+    }
+
+    flow_type flow_value() const
+    {
+        return _flow;
+    }
+
+    // True if u is on the source side of the minimum cut
+    bool min_cut(int u) const
+    {
+        return (_source_side[u / 64] >> (u % 64)) & 1;
+    }
+
+    // The source side of the minimum cut as a bitset: bit u % 64 of word u / 64
+    std::vector<std::uint64_t> const& source_side() const
+    {
+        return _source_side;
+    }
+
+    std::size_t n_phases() const
+    {
+        return _n_phases;
+    }
+};
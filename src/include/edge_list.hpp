@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// What simplify_edges removed
+struct simplify_stats
+{
+    std::size_t n_loops = 0;
+    // Edges merged into another edge between the same two nodes
+    std::size_t n_merged = 0;
+};
+
+// Make an edge list on nodes 0..n_nodes-1 simple, in place: loops are
+// dropped, and all edges between the same two nodes, in either direction,
+// become one edge whose weight is the sum of theirs. Edges come out as
+// (u, v) with u < v, sorted by u then v, whatever the thread count.
+//
+// The edges are bucketed by their smaller node with a counting sort, and
+// the buckets are then sorted and merged in ranges on n_threads threads.
+inline simplify_stats simplify_edges(
+    int n_nodes, std::vector<csr_graph::edge>& edges, unsigned n_threads = 1)
+{
+    simplify_stats stats;
+
+    // Bucket by smaller node; loops go
+    std::vector<int> offsets(std::size_t(n_nodes) + 1, 0);
+    for (csr_graph::edge const& e : edges)
+    {
+        if (e.u != e.v)
+            ++offsets[std::min(e.u, e.v) + 1];
+    }
+    for (int u = 0; u < n_nodes; ++u)
+    {
+        offsets[u + 1] += offsets[u];
+    }
+    std::vector<csr_graph::edge> sorted(offsets[n_nodes]);
+    stats.n_loops = edges.size() - sorted.size();
+    {
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (csr_graph::edge const& e : edges)
+        {
+            if (e.u == e.v)
+                continue;
+            int u = std::min(e.u, e.v);
+            sorted[fill[u]++] = {u, std::max(e.u, e.v), e.weight};
+        }
+    }
+
+    // Sort each bucket by its other node, and merge equal neighbors.
+    // Range r covers the buckets of nodes [r * n / n_ranges, ...), and its
+    // merged edges are left at the start of its part of sorted.
+    std::size_t const n_ranges = std::max(1u, n_threads) * std::size_t(4);
+    std::vector<int> kept(n_ranges, 0);
+    auto merge_range = [&](std::size_t r, unsigned) {
+        int first = int(r * n_nodes / n_ranges);
+        int last = int((r + 1) * n_nodes / n_ranges);
+        int out = offsets[first];
+        for (int u = first; u < last; ++u)
+        {
+            auto begin = sorted.begin() + offsets[u];
+            auto end = sorted.begin() + offsets[u + 1];
+            std::sort(begin, end,
+                [](csr_graph::edge const& a, csr_graph::edge const& b) {
+                    return a.v < b.v;
+                });
+            for (auto e = begin; e != end; ++e)
+            {
+                if (out > offsets[first] && sorted[out - 1].u == u &&
+                    sorted[out - 1].v == e->v)
+                    sorted[out - 1].weight += e->weight;
+                else
+                    sorted[out++] = *e;
+            }
+        }
+        kept[r] = out - offsets[first];
+    };
+    if (n_threads > 1)
+    {
+        thread_pool pool(n_threads);
+        pool.parallel_for(n_ranges, merge_range);
+    }
+    else
+    {
+        for (std::size_t r = 0; r < n_ranges; ++r)
+        {
+            merge_range(r, 0);
+        }
+    }
+
+    // Gather the ranges
+    edges.clear();
+    for (std::size_t r = 0; r < n_ranges; ++r)
+    {
+        auto first = sorted.begin() + offsets[r * n_nodes / n_ranges];
+        edges.insert(edges.end(), first, first + kept[r]);
+    }
+    stats.n_merged = sorted.size() - edges.size();
+    return stats;
+}
+
+// The value of the k-cut that cuts off the k-1 nodes of smallest weighted
+// degree. It bounds the min k-cut value, and the sum of the k-1 smallest
+// flows of any Gomory-Hu tree of the graph.
+inline long long singleton_k_cut_value(
+    int n_nodes, std::vector<csr_graph::edge> const& edges, unsigned int k)
+{
+    std::vector<long long> degree(n_nodes, 0);
+    for (csr_graph::edge const& e : edges)
+    {
+        degree[e.u] += e.weight;
+        degree[e.v] += e.weight;
+    }
+    std::size_t n_cut = std::min<std::size_t>(k > 0 ? k - 1 : 0, n_nodes);
+    std::partial_sort(degree.begin(), degree.begin() + n_cut, degree.end());
+    long long value = 0;
+    for (std::size_t i = 0; i < n_cut; ++i)
+    {
+        value += degree[i];
+    }
+    return value;
+}
+
+// Replace a simple edge list by a Nagamochi-Ibaraki sparse certificate for
+// lambda: a subgraph, with lowered weights, in which every cut of value at
+// most lambda keeps its value, and every other cut keeps a value of at
+// least lambda. Its total weight is at most lambda * (n_nodes - 1). Returns
+// the number of edges dropped.
+//
+// The nodes are scanned in maximum adjacency order. The edge from a scanned
+// node to an unscanned node v, of weight w, goes to the forests
+// r(v) + 1..r(v) + w of the decomposition, where r(v) is the weight between
+// v and the nodes scanned before; only its share of the first lambda
+// forests is kept.
+inline std::size_t sparse_certificate(
+    int n_nodes, std::vector<csr_graph::edge>& edges, long long lambda)
+{
+    // The edges at each node
+    std::vector<int> offsets(std::size_t(n_nodes) + 1, 0);
+    for (csr_graph::edge const& e : edges)
+    {
+        ++offsets[e.u + 1];
+        ++offsets[e.v + 1];
+    }
+    for (int u = 0; u < n_nodes; ++u)
+    {
+        offsets[u + 1] += offsets[u];
+    }
+    std::vector<int> incident(offsets[n_nodes]);
+    {
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < edges.size(); ++i)
+        {
+            incident[fill[edges[i].u]++] = int(i);
+            incident[fill[edges[i].v]++] = int(i);
+        }
+    }
+
+    std::vector<long long> r(n_nodes, 0);
+    std::vector<char> scanned(n_nodes, 0);
+    std::vector<int> kept(edges.size(), 0);
+    // Unscanned nodes by r; stale entries are skipped when popped
+    std::priority_queue<std::pair<long long, int>> queue;
+    for (int start = 0; start < n_nodes; ++start)
+    {
+        if (scanned[start])
+            continue;
+        // A new component
+        queue.emplace(0, start);
+        while (!queue.empty())
+        {
+            auto [r_u, u] = queue.top();
+            queue.pop();
+            if (scanned[u] || r_u != r[u])
+                continue;
+            scanned[u] = 1;
+            for (int a = offsets[u]; a < offsets[u + 1]; ++a)
+            {
+                csr_graph::edge const& e = edges[incident[a]];
+                int v = e.u == u ? e.v : e.u;
+                if (scanned[v])
+                    continue;
+                kept[incident[a]] = static_cast<int>(std::clamp<long long>(
+                    lambda - r[v], 0, e.weight));
+                r[v] += e.weight;
+                queue.emplace(r[v], v);
+            }
+        }
+    }
+
+    std::size_t out = 0;
+    for (std::size_t i = 0; i < edges.size(); ++i)
+    {
+        if (kept[i] > 0)
+            edges[out++] = {edges[i].u, edges[i].v, kept[i]};
+    }
+    std::size_t n_dropped = edges.size() - out;
+    edges.resize(out);
+    return n_dropped;
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "util.hpp"
+
+// Telemetry is on unless built with KCUT_TELEMETRY=0, which compiles the
+// recording out
+#ifndef KCUT_TELEMETRY
+#define KCUT_TELEMETRY 1
+#endif
+
+// One s-t flow of a Gomory-Hu construction
+struct flow_sample
+{
+    // Nodes of the flow graph
+    int s = 0;
+    int t = 0;
+    long long flow = 0;
+    // Nodes on the source side of the cut, in the graph the flow ran on
+    int cut_size = 0;
+    std::uint32_t n_pushes = 0;
+    std::uint32_t n_relabels = 0;
+    // Time of the flow, and of the tree update after it (s)
+    double time_flow = 0;
+    double time_relabel = 0;
+};
+
+// The pushes and relabels of the solvers that count them (push_relabel),
+// as running totals; 0 for the others
+template <typename MaxFlow>
+auto flow_work(MaxFlow const& engine, int)
+    -> decltype(std::pair<std::size_t, std::size_t>(
+        engine.n_pushes(), engine.n_relabels()))
+{
+    return {engine.n_pushes(), engine.n_relabels()};
+}
+
+template <typename MaxFlow>
+std::pair<std::size_t, std::size_t> flow_work(MaxFlow const&, long)
+{
+    return {0, 0};
+}
+
+// The number of nodes in a source side bitset
+inline int cut_side_size(std::vector<std::uint64_t> const& source_side)
+{
+    int size = 0;
+    for (std::uint64_t word : source_side)
+    {
+        size += static_cast<int>(std::bitset<64>(word).count());
+    }
+    return size;
+}
+
+// Per-flow samples of a tree construction, in buffers and histograms of
+// each worker, allocated by start so that recording does not allocate.
+// log writes a summary to global_json_logger:
+//   <prefix>_flow_time_p50, _p90, _p99, _max   flow latency percentiles (s)
+//   <prefix>_flow_time_histogram   flows per time bucket: bucket 0 is below
+//                                  1 us, bucket b in [2^(b-1), 2^b) us
+//   <prefix>_flow_pushes, _flow_relabels       totals over the flows
+//   <prefix>_slowest_flows   the slowest flows, each as
+//                            s-t:time:flow:cut_size:pushes:relabels:relabel
+//                            with s and t mapped to graph node ids
+class flow_telemetry
+{
+public:
+    static constexpr bool enabled = KCUT_TELEMETRY != 0;
+    static constexpr int n_buckets = 32;
+    static constexpr std::size_t n_slowest = 5;
+
+private:
+    struct worker_log
+    {
+        std::vector<flow_sample> samples;
+        std::array<std::uint64_t, n_buckets> histogram{};
+    };
+    std::vector<worker_log> _workers;
+    bool _active = false;
+
+    static int bucket(double time)
+    {
+        auto us = static_cast<std::uint64_t>(time * 1e6);
+        int b = 0;
+        while (us > 0 && b < n_buckets - 1)
+        {
+            us >>= 1;
+            ++b;
+        }
+        return b;
+    }
+
+public:
+    // Clear the samples, and make room for about n_flows flows on n_workers
+    // workers
+    void start([[maybe_unused]] unsigned n_workers,
+        [[maybe_unused]] std::size_t n_flows)
+    {
+        if constexpr (enabled)
+        {
+            _workers.resize(n_workers);
+            for (worker_log& w : _workers)
+            {
+                w.samples.clear();
+                w.samples.reserve(n_flows / n_workers + 1);
+                w.histogram.fill(0);
+            }
+            _active = true;
+        }
+    }
+
+    // Record a flow; ignored unless started. Each worker records on its own.
+    void record([[maybe_unused]] unsigned worker,
+        [[maybe_unused]] flow_sample const& sample)
+    {
+        if constexpr (enabled)
+        {
+            if (!_active)
+                return;
+            worker_log& w = _workers[worker];
+            w.samples.push_back(sample);
+            ++w.histogram[bucket(sample.time_flow)];
+        }
+    }
+
+    // Write the summary of the samples, whose nodes node_id maps to graph
+    // node ids, and stop recording
+    template <typename NodeId>
+    void log([[maybe_unused]] std::string const& prefix,
+        [[maybe_unused]] NodeId node_id)
+    {
+        if constexpr (enabled)
+        {
+            if (!_active)
+                return;
+            _active = false;
+
+            std::vector<flow_sample> samples;
+            std::array<std::uint64_t, n_buckets> histogram{};
+            for (worker_log const& w : _workers)
+            {
+                samples.insert(samples.end(), w.samples.begin(),
+                    w.samples.end());
+                for (int b = 0; b < n_buckets; ++b)
+                {
+                    histogram[b] += w.histogram[b];
+                }
+            }
+            if (samples.empty())
+                return;
+
+            // Slowest first
+            std::sort(samples.begin(), samples.end(),
+                [](flow_sample const& a, flow_sample const& b) {
+                    return a.time_flow > b.time_flow;
+                });
+            auto percentile = [&](double p) {
+                std::size_t rank = static_cast<std::size_t>(
+                    (1 - p) * double(samples.size()));
+                return samples[std::min(rank, samples.size() - 1)].time_flow;
+            };
+            global_json_logger.add(prefix + "_flow_time_p50", percentile(0.5));
+            global_json_logger.add(prefix + "_flow_time_p90", percentile(0.9));
+            global_json_logger.add(
+                prefix + "_flow_time_p99", percentile(0.99));
+            global_json_logger.add(
+                prefix + "_flow_time_max", samples[0].time_flow);
+
+            int last = n_buckets - 1;
+            while (last > 0 && histogram[last] == 0)
+                --last;
+            std::string buckets;
+            for (int b = 0; b <= last; ++b)
+            {
+                buckets += (b > 0 ? " " : "") + std::to_string(histogram[b]);
+            }
+            global_json_logger.add(prefix + "_flow_time_histogram", buckets);
+
+            std::size_t n_pushes = 0;
+            std::size_t n_relabels = 0;
+            for (flow_sample const& sample : samples)
+            {
+                n_pushes += sample.n_pushes;
+                n_relabels += sample.n_relabels;
+            }
+            global_json_logger.add(prefix + "_flow_pushes", n_pushes);
+            global_json_logger.add(prefix + "_flow_relabels", n_relabels);
+
+            std::string slowest;
+            for (std::size_t i = 0; i < std::min(n_slowest, samples.size());
+                 ++i)
+            {
+                flow_sample const& f = samples[i];
+                slowest += (i > 0 ? " " : "") +
+                    std::to_string(node_id(f.s)) + "-" +
+                    std::to_string(node_id(f.t)) + ":" +
+                    std::to_string(f.time_flow) + ":" +
+                    std::to_string(f.flow) + ":" +
+                    std::to_string(f.cut_size) + ":" +
+                    std::to_string(f.n_pushes) + ":" +
+                    std::to_string(f.n_relabels) + ":" +
+                    std::to_string(f.time_relabel);
+            }
+            global_json_logger.add(prefix + "_slowest_flows", slowest);
+        }
+    }
+};
+
+// Measures a flow of an engine, from the construction of the probe, before
+// the run, to finish, after it
+template <typename MaxFlow>
+class flow_probe
+{
+    MaxFlow const& _engine;
+    std::chrono::steady_clock::time_point _start;
+    std::pair<std::size_t, std::size_t> _work;
+
+public:
+    explicit flow_probe(MaxFlow const& engine) : _engine(engine)
+    {
+        if constexpr (flow_telemetry::enabled)
+        {
+            _start = std::chrono::steady_clock::now();
+            _work = flow_work(engine, 0);
+        }
+    }
+
+    // The sample of the flow from s to t, without its time_relabel
+    flow_sample finish([[maybe_unused]] int s, [[maybe_unused]] int t) const
+    {
+        flow_sample sample;
+        if constexpr (flow_telemetry::enabled)
+        {
+            sample.time_flow = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - _start)
+                                   .count();
+            auto work = flow_work(_engine, 0);
+            sample.s = s;
+            sample.t = t;
+            sample.flow = static_cast<long long>(_engine.flow_value());
+            sample.cut_size = cut_side_size(_engine.source_side());
+            sample.n_pushes = std::uint32_t(work.first - _work.first);
+            sample.n_relabels = std::uint32_t(work.second - _work.second);
+        }
+        return sample;
+    }
+};
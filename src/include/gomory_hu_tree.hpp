@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <lemon/list_graph.h>
+#include <string>
+#include <vector>
+#include "cut_query_index.hpp"
+#include "graph_cache.hpp"
+#include "mapped_file.hpp"
+
+// A Gomory-Hu tree in parent form, detached from the graph it was built
+// for, so that it can be saved once and queried by later processes.
+// Tree node i has parent parent(i) (-1 for the root), the edge to it has
+// flow flow(i), and i stands for graph node label(i).
+//
+// The file is a gomory_hu_tree_header followed by the parent, flow and
+// label arrays, as int32. As for graph caches, the numbers are in the byte
+// order of the writer, and the checksum covers everything after the header.
+struct gomory_hu_tree_header
+{
+    static constexpr char magic_value[8] = {
+        'M', 'K', 'C', 'G', 'H', 'T', 'R', 'E'};
+    static constexpr std::uint32_t current_version = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::int64_t n_nodes;
+    std::uint64_t checksum;
+};
+static_assert(sizeof(gomory_hu_tree_header) == 32);
+
+class gomory_hu_tree
+{
+    using ListGraph = lemon::ListGraph;
+
+    std::vector<int> _parent;
+    std::vector<int> _flow;
+    std::vector<int> _label;
+
+    // Query indexes, derived from the arrays above by index()
+    cut_query_index _cuts;
+    // Tree node of each label, or -1
+    std::vector<int> _node;
+    // Sums of the k smallest flows
+    std::vector<long long> _smallest_sums;
+
+    // Returns false if the parents have a cycle
+    bool index()
+    {
+        int const n = n_nodes();
+
+        // Depths, from the root down; parents may come after their children.
+        // -2 marks the nodes on the current path. They are only used to
+        // find cycles.
+        std::vector<int> depth(n, -1);
+        std::vector<int> path;
+        for (int i = 0; i < n; ++i)
+        {
+            int u = i;
+            while (u != -1 && depth[u] == -1)
+            {
+                depth[u] = -2;
+                path.push_back(u);
+                u = _parent[u];
+            }
+            if (u != -1 && depth[u] == -2)
+                return false;
+            int d = u == -1 ? -1 : depth[u];
+            while (!path.empty())
+            {
+                depth[path.back()] = ++d;
+                path.pop_back();
+            }
+        }
+
+        int max_label = -1;
+        for (int l : _label)
+        {
+            max_label = std::max(max_label, l);
+        }
+        _node.assign(max_label + 1, -1);
+        for (int i = 0; i < n; ++i)
+        {
+            if (_label[i] >= 0)
+                _node[_label[i]] = i;
+        }
+
+        _cuts.build(_parent, _flow);
+
+        std::vector<int> flows;
+        for (int i = 0; i < n; ++i)
+        {
+            if (_parent[i] != -1)
+                flows.push_back(_flow[i]);
+        }
+        std::sort(flows.begin(), flows.end());
+        _smallest_sums.assign(1, 0);
+        for (int f : flows)
+        {
+            _smallest_sums.push_back(_smallest_sums.back() + f);
+        }
+        return true;
+    }
+
+public:
+    gomory_hu_tree() = default;
+
+    // Take the tree of k_min_cut (_tree, _tree_flows, _tree_labels), rooted
+    // at its first node
+    void build(ListGraph const& tree, ListGraph::EdgeMap<int> const& flows,
+        ListGraph::NodeMap<int> const& labels)
+    {
+        int const n = tree.maxNodeId() + 1;
+        _parent.assign(n, -1);
+        _flow.assign(n, 0);
+        _label.assign(n, -1);
+
+        std::vector<char> visited(n, 0);
+        std::vector<ListGraph::Node> stack;
+        for (ListGraph::NodeIt root(tree); root != lemon::INVALID; ++root)
+        {
+            if (visited[tree.id(root)])
+                continue;
+            visited[tree.id(root)] = 1;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                ListGraph::Node u = stack.back();
+                stack.pop_back();
+                _label[tree.id(u)] = labels[u];
+                for (ListGraph::IncEdgeIt e(tree, u); e != lemon::INVALID;
+                     ++e)
+                {
+                    ListGraph::Node v = tree.oppositeNode(u, e);
+                    if (!visited[tree.id(v)])
+                    {
+                        visited[tree.id(v)] = 1;
+                        _parent[tree.id(v)] = tree.id(u);
+                        _flow[tree.id(v)] = flows[e];
+                        stack.push_back(v);
+                    }
+                }
+            }
+        }
+
+        index();
+    }
+
+    int n_nodes() const
+    {
+        return static_cast<int>(_parent.size());
+    }
+
+    int parent(int i) const
+    {
+        return _parent[i];
+    }
+
+    int flow(int i) const
+    {
+        return _flow[i];
+    }
+
+    int label(int i) const
+    {
+        return _label[i];
+    }
+
+    // The tree node of graph node label, or -1
+    int node(int label) const
+    {
+        return label >= 0 && label < int(_node.size()) ? _node[label] : -1;
+    }
+
+    // The min cut between tree nodes s and t: the smallest flow on the tree
+    // path between them, 0 between trees of a forest. Constant time.
+    int min_cut(int s, int t) const
+    {
+        return _cuts.min_cut(s, t);
+    }
+
+    // values[i] = min_cut(s[i], t[i]) for i < count
+    void min_cuts(
+        std::size_t count, int const* s, int const* t, int* values) const
+    {
+        _cuts.min_cuts(count, s, t, values);
+    }
+
+    // The sum of the k-1 smallest flows, the value of the min k-cut found
+    // by k_min_cut::min_k_cut_value. Constant time.
+    long long min_k_cut_value(unsigned int k) const
+    {
+        std::size_t n_cuts = std::min<std::size_t>(
+            k > 0 ? k - 1 : 0, _smallest_sums.size() - 1);
+        return _smallest_sums[n_cuts];
+    }
+
+    // Returns false if the file cannot be written
+    bool write(std::string const& path) const
+    {
+        std::vector<std::int32_t> payload;
+        payload.reserve(3 * _parent.size());
+        payload.insert(payload.end(), _parent.begin(), _parent.end());
+        payload.insert(payload.end(), _flow.begin(), _flow.end());
+        payload.insert(payload.end(), _label.begin(), _label.end());
+
+        gomory_hu_tree_header h{};
+        std::memcpy(h.magic, gomory_hu_tree_header::magic_value, 8);
+        h.version = gomory_hu_tree_header::current_version;
+        h.byte_order = graph_cache_header::byte_order_value;
+        h.n_nodes = n_nodes();
+        h.checksum = graph_cache_checksum(
+            payload.data(), payload.size() * sizeof(std::int32_t));
+
+        std::ofstream os(path, std::ios::binary);
+        os.write(reinterpret_cast<char const*>(&h), sizeof(h));
+        os.write(reinterpret_cast<char const*>(payload.data()),
+            payload.size() * sizeof(std::int32_t));
+        if (!os)
+        {
+            std::cerr << "Cannot write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Returns false, and says why on std::cerr, if the file cannot be read
+    // or is not a valid tree
+    bool read(std::string const& path)
+    {
+        mapped_file file;
+        if (!file.open(path))
+        {
+            std::cerr << "Cannot open " << path << std::endl;
+            return false;
+        }
+
+        auto fail = [&](char const* what) {
+            std::cerr << "Invalid Gomory-Hu tree " << path << ": " << what
+                      << std::endl;
+            return false;
+        };
+
+        if (file.size() < sizeof(gomory_hu_tree_header))
+            return fail("too short");
+        gomory_hu_tree_header h;
+        std::memcpy(&h, file.data(), sizeof(h));
+        if (std::memcmp(h.magic, gomory_hu_tree_header::magic_value, 8) != 0)
+            return fail("bad magic");
+        if (h.byte_order != graph_cache_header::byte_order_value)
+            return fail("other byte order");
+        if (h.version != gomory_hu_tree_header::current_version)
+            return fail("unsupported version");
+        if (h.n_nodes < 0 || h.n_nodes > std::numeric_limits<int>::max())
+            return fail("bad size");
+        std::size_t const n = std::size_t(h.n_nodes);
+        std::size_t payload = 3 * n * sizeof(std::int32_t);
+        if (file.size() != sizeof(h) + payload)
+            return fail("wrong file size");
+        char const* data = file.data() + sizeof(h);
+        if (graph_cache_checksum(data, payload) != h.checksum)
+            return fail("bad checksum");
+
+        _parent.resize(n);
+        _flow.resize(n);
+        _label.resize(n);
+        std::memcpy(_parent.data(), data, n * sizeof(std::int32_t));
+        std::memcpy(_flow.data(), data + n * 4, n * sizeof(std::int32_t));
+        std::memcpy(_label.data(), data + n * 8, n * sizeof(std::int32_t));
+
+        // The parents must form a forest
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (_parent[i] < -1 || _parent[i] >= int(n))
+                return fail("bad parents");
+        }
+        if (!index())
+            return fail("cycle in parents");
+        return true;
+    }
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "csr_graph.hpp"
+#include "mapped_file.hpp"
+#include "reader_util.hpp"
+
+// A binary graph file that is used in place from a memory mapping, with no
+// parsing. It holds an undirected graph in CSR layout:
+//
+//   graph_cache_header   64 bytes
+//   offsets              n_nodes + 1 int32, the arcs out of u are
+//                        [offsets[u], offsets[u + 1])
+//   targets              n_arcs int32
+//   weights              n_arcs int32
+//
+// Every edge is two arcs, as in csr_graph. Numbers are in the byte order of
+// the machine that wrote the file; a file from a machine with the other
+// order is rejected. The checksum covers everything after the header.
+struct graph_cache_header
+{
+    static constexpr char magic_value[8] = {
+        'M', 'K', 'C', 'G', 'R', 'A', 'P', 'H'};
+    static constexpr std::uint32_t current_version = 1;
+    static constexpr std::uint32_t byte_order_value = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::int64_t n_nodes;
+    std::int64_t n_arcs;
+    std::uint64_t checksum;
+    std::uint64_t reserved[3];
+};
+static_assert(sizeof(graph_cache_header) == 64);
+
+// A 64-bit checksum of [data, data + size), eight bytes at a time
+inline std::uint64_t graph_cache_checksum(void const* data, std::size_t size)
+{
+    unsigned char const* p = static_cast<unsigned char const*>(data);
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        std::uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < size; ++i)
+    {
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+// A graph cache file, mapped and checked by open. The arrays point into
+// the mapping.
+class graph_cache
+{
+    mapped_file _file;
+    graph_cache_header const* _header = nullptr;
+
+public:
+    // Returns false, and says why on std::cerr, if the file cannot be read
+    // or is not a valid graph cache
+    bool open(std::string const& path)
+    {
+        _header = nullptr;
+        if (!_file.open(path))
+        {
+            std::cerr << "Cannot open " << path << std::endl;
+            return false;
+        }
+
+        auto fail = [&](char const* what) {
+            std::cerr << "Invalid graph cache " << path << ": " << what
+                      << std::endl;
+            _file.close();
+            return false;
+        };
+
+        if (_file.size() < sizeof(graph_cache_header))
+            return fail("too short");
+        auto const* h =
+            reinterpret_cast<graph_cache_header const*>(_file.data());
+        if (std::memcmp(h->magic, graph_cache_header::magic_value, 8) != 0)
+            return fail("bad magic");
+        if (h->byte_order != graph_cache_header::byte_order_value)
+            return fail("other byte order");
+        if (h->version != graph_cache_header::current_version)
+            return fail("unsupported version");
+        if (h->n_nodes < 0 || h->n_arcs < 0 || h->n_nodes >= INT32_MAX ||
+            h->n_arcs > INT32_MAX)
+            return fail("bad sizes");
+        std::size_t payload = sizeof(std::int32_t) *
+            std::size_t(h->n_nodes + 1 + 2 * h->n_arcs);
+        if (_file.size() != sizeof(graph_cache_header) + payload)
+            return fail("wrong file size");
+        if (graph_cache_checksum(h + 1, payload) != h->checksum)
+            return fail("bad checksum");
+
+        _header = h;
+
+        // The checksum does not protect against a bad writer
+        int const n = n_nodes();
+        int const* off = offsets();
+        int const* tgt = targets();
+        if (off[0] != 0 || off[n] != n_arcs())
+            return fail("bad offsets");
+        for (int u = 0; u < n; ++u)
+        {
+            if (off[u] > off[u + 1])
+                return fail("bad offsets");
+        }
+        for (int a = 0; a < n_arcs(); ++a)
+        {
+            if (tgt[a] < 0 || tgt[a] >= n)
+                return fail("bad targets");
+        }
+        return true;
+    }
+
+    int n_nodes() const
+    {
+        return static_cast<int>(_header->n_nodes);
+    }
+
+    int n_arcs() const
+    {
+        return static_cast<int>(_header->n_arcs);
+    }
+
+    int const* offsets() const
+    {
+        return reinterpret_cast<int const*>(_header + 1);
+    }
+
+    int const* targets() const
+    {
+        return offsets() + n_nodes() + 1;
+    }
+
+    int const* weights() const
+    {
+        return targets() + n_arcs();
+    }
+
+    // The undirected edges: the arcs u->v with u < v, by u
+    void edges(std::vector<csr_graph::edge>& out) const
+    {
+        out.clear();
+        out.reserve(n_arcs() / 2);
+        int const* off = offsets();
+        int const* tgt = targets();
+        int const* w = weights();
+        for (int u = 0; u < n_nodes(); ++u)
+        {
+            for (int a = off[u]; a < off[u + 1]; ++a)
+            {
+                if (u < tgt[a])
+                    out.push_back({u, tgt[a], w[a]});
+            }
+        }
+    }
+};
+
+// Write g to path as a graph cache. Returns false if the file cannot be
+// written.
+inline bool writeGraphCache(csr_graph const& g, std::string const& path)
+{
+    int const n = g.n_nodes();
+    int const n_arcs = g.n_arcs();
+
+    // The payload, laid out as in the file
+    std::vector<std::int32_t> payload;
+    payload.reserve(std::size_t(n) + 1 + 2 * std::size_t(n_arcs));
+    payload.insert(payload.end(), g.offsets(), g.offsets() + n + 1);
+    payload.insert(payload.end(), g.targets(), g.targets() + n_arcs);
+    payload.insert(payload.end(), g.capacities(), g.capacities() + n_arcs);
+
+    graph_cache_header h{};
+    std::memcpy(h.magic, graph_cache_header::magic_value, 8);
+    h.version = graph_cache_header::current_version;
+    h.byte_order = graph_cache_header::byte_order_value;
+    h.n_nodes = n;
+    h.n_arcs = n_arcs;
+    h.checksum = graph_cache_checksum(
+        payload.data(), payload.size() * sizeof(std::int32_t));
+
+    std::ofstream os(path, std::ios::binary);
+    os.write(reinterpret_cast<char const*>(&h), sizeof(h));
+    os.write(reinterpret_cast<char const*>(payload.data()),
+        payload.size() * sizeof(std::int32_t));
+    if (!os)
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// True if the file at path starts like a graph cache
+inline bool isGraphCache(std::string const& path)
+{
+    char magic[8];
+    std::ifstream is(path, std::ios::binary);
+    return is.read(magic, 8) &&
+        std::memcmp(magic, graph_cache_header::magic_value, 8) == 0;
+}
+
+// Read a graph cache file into graph. Node i of the graph is node i of the
+// file. Returns false if the file cannot be read or is invalid.
+template <typename Graph, typename ArcMap>
+bool readGraphCache(Graph& graph, ArcMap& arc_map, std::string const& path)
+{
+    graph.clear();
+
+    graph_cache cache;
+    if (!cache.open(path))
+        return false;
+
+    std::vector<csr_graph::edge> edges;
+    cache.edges(edges);
+    fill_graph(graph, arc_map, cache.n_nodes(), edges);
+    return true;
+}
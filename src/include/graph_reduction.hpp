@@ -0,0 +1,453 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <lemon/core.h>
+#include <lemon/list_graph.h>
+#include <vector>
+#include "contracted_graph.hpp"
+#include "csr_graph.hpp"
+#include "push_relabel.hpp"
+
+// Removes the nodes of degree 1 and 2 from a graph before its Gomory-Hu tree
+// is built, and puts them back into the tree of what is left (the core).
+//
+// A node v with a single edge, of weight w to a, is peeled: removing it
+// changes no min cut between two other nodes, and in the tree it hangs from
+// a with flow w. This peels pendant trees entirely.
+//
+// A node v with two edges, of weights wa >= wb to a and b, is spliced out:
+// it is replaced by an edge a-b of weight wb, merged with the a-b edge if
+// there is one. Again no min cut between two other nodes changes. Putting
+// v back into a's tree node keeps the value of every cut of the tree, so
+// what is left is one Gomory-Hu split of the supernode {a, v}. The cut {v}
+// is a minimum a-v cut exactly when the a-b min cut is at least 2 wb, which
+// is read off the tree, and then v hangs from a with flow wa + wb.
+// Otherwise the split takes one max flow, on the graph contracted along the
+// tree, which has as many nodes as a has tree neighbors (plus two).
+// Long chains are spliced one node at a time. The graph the splits contract
+// is one CSR graph of every edge that the expansion ever has, built once,
+// whose capacities are kept up to date as the nodes come back.
+//
+// Padberg-Rinaldi contractions are not applied here: they keep a minimum
+// global cut, but not the min cuts of all pairs.
+class graph_reduction
+{
+    using ListGraph = lemon::ListGraph;
+    static constexpr auto INVALID = lemon::INVALID;
+
+    // A removed node, in removal order. b is -1 if v was peeled.
+    struct step
+    {
+        int v;
+        int a;
+        int b;
+        int wa;
+        int wb;
+        // True if the splice added the a-b edge rather than adding to it
+        bool new_edge;
+    };
+
+    int _n_nodes = 0;
+    std::vector<step> _steps;
+
+    // Core node i is graph node _core_nodes[i]
+    std::vector<int> _core_nodes;
+    csr_graph _core;
+
+    // Scratch for expand. _csr has every edge of the expansion, and
+    // _capacity the weight of each arc in the graph as it is now (0 if the
+    // edge is not there yet, or any more).
+    std::vector<unsigned> _mark;
+    unsigned _stamp = 0;
+    std::vector<int> _queue;
+    std::vector<int> _label;
+    std::vector<int> _split_nodes;
+    csr_graph _csr;
+    std::vector<int> _capacity;
+    contracted_graph _contraction;
+    push_relabel _min_cut;
+    std::size_t _n_split_flows = 0;
+
+    // True if a and b are joined in the tree by a path whose flows are all
+    // at least threshold
+    bool connected_above(ListGraph const& tree,
+        ListGraph::EdgeMap<int> const& flow, int a, int b,
+        std::int64_t threshold)
+    {
+        ++_stamp;
+        _mark[a] = _stamp;
+        _queue.clear();
+        _queue.push_back(a);
+        for (std::size_t head = 0; head < _queue.size(); ++head)
+        {
+            ListGraph::Node u = tree.nodeFromId(_queue[head]);
+            for (ListGraph::IncEdgeIt e(tree, u); e != INVALID; ++e)
+            {
+                int w = tree.id(tree.oppositeNode(u, e));
+                if (_mark[w] == _stamp || flow[e] < threshold)
+                    continue;
+                if (w == b)
+                    return true;
+                _mark[w] = _stamp;
+                _queue.push_back(w);
+            }
+        }
+        return false;
+    }
+
+    // Add w to the weight of the edge u-v of _csr
+    void add_weight(int u, int v, int w)
+    {
+        for (int arc = _csr.begin(u); arc < _csr.end(u); ++arc)
+        {
+            if (_csr.target(arc) == v)
+            {
+                _capacity[arc] += w;
+                _capacity[_csr.reverse(arc)] += w;
+                return;
+            }
+        }
+    }
+
+    // Split the supernode {a, v} of the tree with a max flow between a and
+    // v in the graph, where every component of the tree minus a is
+    // contracted
+    void split(ListGraph& tree, ListGraph::EdgeMap<int>& flow, int a, int v)
+    {
+        ++_n_split_flows;
+
+        // Only a, v and the components around a are labelled: the tree spans
+        // the nodes put back so far, and the others have no edges yet
+        _split_nodes.clear();
+        _split_nodes.push_back(a);
+        _split_nodes.push_back(v);
+        _label[a] = 0;
+        _label[v] = 1;
+        int n_labels = 2;
+        ++_stamp;
+        _mark[a] = _stamp;
+        std::vector<ListGraph::Edge> a_edges;
+        for (ListGraph::IncEdgeIt e(tree, tree.nodeFromId(a)); e != INVALID;
+             ++e)
+        {
+            a_edges.push_back(e);
+            int first = tree.id(tree.oppositeNode(tree.nodeFromId(a), e));
+            _mark[first] = _stamp;
+            std::size_t head = _split_nodes.size();
+            _split_nodes.push_back(first);
+            for (; head < _split_nodes.size(); ++head)
+            {
+                int u = _split_nodes[head];
+                _label[u] = n_labels;
+                ListGraph::Node node = tree.nodeFromId(u);
+                for (ListGraph::IncEdgeIt f(tree, node); f != INVALID; ++f)
+                {
+                    int w = tree.id(tree.oppositeNode(node, f));
+                    if (_mark[w] != _stamp)
+                    {
+                        _mark[w] = _stamp;
+                        _split_nodes.push_back(w);
+                    }
+                }
+            }
+            ++n_labels;
+        }
+
+        _contraction.build(
+            _csr, _capacity.data(), _split_nodes, _label, n_labels);
+        _min_cut.run(_contraction.graph(), 0, 1);
+
+        // The components on the sink side move from a to v
+        ListGraph::Node a_node = tree.nodeFromId(a);
+        ListGraph::Node v_node = tree.nodeFromId(v);
+        for (ListGraph::Edge e : a_edges)
+        {
+            ListGraph::Node r = tree.oppositeNode(a_node, e);
+            if (!_min_cut.min_cut(_label[tree.id(r)]))
+            {
+                ListGraph::Edge f = tree.addEdge(v_node, r);
+                flow[f] = flow[e];
+                tree.erase(e);
+            }
+        }
+        ListGraph::Edge e = tree.addEdge(a_node, v_node);
+        flow[e] = static_cast<int>(_min_cut.flow_value());
+    }
+
+public:
+    graph_reduction() = default;
+
+    graph_reduction(graph_reduction const&) = delete;
+    graph_reduction& operator=(graph_reduction const&) = delete;
+
+    // Reduce g. Parallel edges of g are merged.
+    void reduce(csr_graph const& g)
+    {
+        int const n = g.n_nodes();
+        _n_nodes = n;
+        _steps.clear();
+
+        ListGraph graph;
+        ListGraph::EdgeMap<int> weights(graph);
+        graph.reserveNode(n);
+        for (int i = 0; i < n; ++i)
+        {
+            graph.addNode();
+        }
+
+        // Edge to each neighbor of the node being scanned, to merge parallel
+        // edges. edge_to[v] is valid if edge_owner[v] is the node.
+        std::vector<int> edge_owner(n, -1);
+        std::vector<ListGraph::Edge> edge_to(n);
+        for (int u = 0; u < n; ++u)
+        {
+            for (int a = g.begin(u); a < g.end(u); ++a)
+            {
+                int v = g.target(a);
+                if (v <= u)
+                    continue;
+                if (edge_owner[v] == u)
+                {
+                    weights[edge_to[v]] += g.capacity(a);
+                }
+                else
+                {
+                    edge_owner[v] = u;
+                    edge_to[v] = graph.addEdge(
+                        graph.nodeFromId(u), graph.nodeFromId(v));
+                    weights[edge_to[v]] = g.capacity(a);
+                }
+            }
+        }
+
+        // Degrees never grow: a splice takes an edge from a and b and gives
+        // them at most one back. So each node is queued once it has at most
+        // two edges, and checked again when it comes out.
+        std::vector<int> degree(n, 0);
+        std::vector<char> removed(n, 0);
+        std::vector<int> queue;
+        for (ListGraph::EdgeIt e(graph); e != INVALID; ++e)
+        {
+            ++degree[graph.id(graph.u(e))];
+            ++degree[graph.id(graph.v(e))];
+        }
+        for (int u = n - 1; u >= 0; --u)
+        {
+            if (degree[u] <= 2)
+                queue.push_back(u);
+        }
+        auto lose_edge = [&](int u) {
+            if (--degree[u] == 2 || degree[u] == 1)
+                queue.push_back(u);
+        };
+
+        int n_left = n;
+        while (!queue.empty())
+        {
+            int v = queue.back();
+            queue.pop_back();
+            if (removed[v] || degree[v] == 0 || n_left <= 2)
+                continue;
+
+            ListGraph::Node node = graph.nodeFromId(v);
+            ListGraph::IncEdgeIt e(graph, node);
+            ListGraph::Edge e1 = e;
+            int x = graph.id(graph.oppositeNode(node, e1));
+            int wx = weights[e1];
+
+            if (degree[v] == 1)
+            {
+                graph.erase(e1);
+                lose_edge(x);
+                _steps.push_back({v, x, -1, wx, 0, false});
+            }
+            else
+            {
+                ListGraph::Edge e2 = ++e;
+                int y = graph.id(graph.oppositeNode(node, e2));
+                int wy = weights[e2];
+                graph.erase(e1);
+                graph.erase(e2);
+
+                step s = wx >= wy ? step{v, x, y, wx, wy, false}
+                                  : step{v, y, x, wy, wx, false};
+                ListGraph::Node a = graph.nodeFromId(s.a);
+                ListGraph::Node b = graph.nodeFromId(s.b);
+                ListGraph::Edge ab = lemon::findEdge(graph, a, b);
+                if (ab != INVALID)
+                {
+                    weights[ab] += s.wb;
+                    lose_edge(s.a);
+                    lose_edge(s.b);
+                }
+                else
+                {
+                    ab = graph.addEdge(a, b);
+                    weights[ab] = s.wb;
+                    s.new_edge = true;
+                }
+                _steps.push_back(s);
+            }
+            removed[v] = 1;
+            degree[v] = 0;
+            --n_left;
+        }
+
+        // The core is what is left
+        _core_nodes.clear();
+        std::vector<int> index(n, -1);
+        for (int u = 0; u < n; ++u)
+        {
+            if (!removed[u])
+            {
+                index[u] = static_cast<int>(_core_nodes.size());
+                _core_nodes.push_back(u);
+            }
+        }
+        std::vector<csr_graph::edge> edges;
+        for (ListGraph::EdgeIt e(graph); e != INVALID; ++e)
+        {
+            edges.push_back({index[graph.id(graph.u(e))],
+                index[graph.id(graph.v(e))], weights[e]});
+        }
+        _core.build(static_cast<int>(_core_nodes.size()), edges);
+    }
+
+    // The graph left by reduce
+    csr_graph const& core() const
+    {
+        return _core;
+    }
+
+    // The node of the reduced graph that core node i is
+    int original(int i) const
+    {
+        return _core_nodes[i];
+    }
+
+    std::size_t n_removed() const
+    {
+        return _steps.size();
+    }
+
+    // Number of removed nodes whose place in the tree took a max flow, in
+    // the last expand
+    std::size_t n_split_flows() const
+    {
+        return _n_split_flows;
+    }
+
+    // Turn a Gomory-Hu tree of the core (edges between core nodes, weighted
+    // by flow) into a Gomory-Hu tree of the reduced graph (edges between its
+    // nodes)
+    std::vector<csr_graph::edge> expand(
+        std::vector<csr_graph::edge> const& core_tree)
+    {
+        _n_split_flows = 0;
+        _mark.assign(_n_nodes, 0);
+        _stamp = 0;
+
+        ListGraph tree;
+        ListGraph::EdgeMap<int> flow(tree);
+        tree.reserveNode(_n_nodes);
+        for (int i = 0; i < _n_nodes; ++i)
+        {
+            tree.addNode();
+        }
+        for (csr_graph::edge const& e : core_tree)
+        {
+            ListGraph::Edge f = tree.addEdge(tree.nodeFromId(_core_nodes[e.u]),
+                tree.nodeFromId(_core_nodes[e.v]));
+            flow[f] = e.weight;
+        }
+
+        // The graph as it was before each removal, put back backwards from
+        // the core, for the splits. Its edges are those of the core and of
+        // the steps, each pair of nodes once.
+        std::vector<csr_graph::edge> graph_edges;
+        for (int u = 0; u < _core.n_nodes(); ++u)
+        {
+            for (int a = _core.begin(u); a < _core.end(u); ++a)
+            {
+                int v = _core.target(a);
+                if (v > u)
+                    graph_edges.push_back({_core_nodes[u], _core_nodes[v], 0});
+            }
+        }
+        for (step const& s : _steps)
+        {
+            graph_edges.push_back({s.v, s.a, 0});
+            if (s.b != -1)
+                graph_edges.push_back({s.v, s.b, 0});
+            if (s.new_edge)
+                graph_edges.push_back({s.a, s.b, 0});
+        }
+        for (csr_graph::edge& e : graph_edges)
+        {
+            if (e.u > e.v)
+                std::swap(e.u, e.v);
+        }
+        std::sort(graph_edges.begin(), graph_edges.end(),
+            [](csr_graph::edge const& x, csr_graph::edge const& y) {
+                return x.u != y.u ? x.u < y.u : x.v < y.v;
+            });
+        graph_edges.erase(std::unique(graph_edges.begin(), graph_edges.end(),
+                              [](csr_graph::edge const& x,
+                                  csr_graph::edge const& y) {
+                                  return x.u == y.u && x.v == y.v;
+                              }),
+            graph_edges.end());
+        _csr.build(_n_nodes, graph_edges);
+        _capacity.assign(_csr.n_arcs(), 0);
+        _label.assign(_n_nodes, 0);
+        for (int u = 0; u < _core.n_nodes(); ++u)
+        {
+            for (int a = _core.begin(u); a < _core.end(u); ++a)
+            {
+                int v = _core.target(a);
+                if (v > u)
+                {
+                    add_weight(
+                        _core_nodes[u], _core_nodes[v], _core.capacity(a));
+                }
+            }
+        }
+
+        for (auto it = _steps.rbegin(); it != _steps.rend(); ++it)
+        {
+            step const& s = *it;
+            add_weight(s.v, s.a, s.wa);
+            if (s.b == -1)
+            {
+                ListGraph::Edge e =
+                    tree.addEdge(tree.nodeFromId(s.v), tree.nodeFromId(s.a));
+                flow[e] = s.wa;
+                continue;
+            }
+
+            // Undo the splice. An edge the splice added goes back to 0.
+            add_weight(s.a, s.b, -s.wb);
+            add_weight(s.v, s.b, s.wb);
+
+            if (connected_above(tree, flow, s.a, s.b, 2 * std::int64_t(s.wb)))
+            {
+                ListGraph::Edge e =
+                    tree.addEdge(tree.nodeFromId(s.v), tree.nodeFromId(s.a));
+                flow[e] = s.wa + s.wb;
+            }
+            else
+            {
+                split(tree, flow, s.a, s.v);
+            }
+        }
+
+        std::vector<csr_graph::edge> edges;
+        for (ListGraph::EdgeIt e(tree); e != INVALID; ++e)
+        {
+            edges.push_back(
+                {tree.id(tree.u(e)), tree.id(tree.v(e)), flow[e]});
+        }
+        return edges;
+    }
+};
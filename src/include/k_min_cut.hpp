@@ -1,14 +1,37 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <functional>
 #include <iostream>
-#include <lemon/dfs.h>
+#include <memory>
 #include <lemon/lgf_reader.h>
 #include <lemon/list_graph.h>
-#include <lemon/preflow.h>
-#include <stack>
+#include <shared_mutex>
+#include <unordered_map>
+#include "block_decomposition.hpp"
+#include "contracted_graph.hpp"
+#include "cut_query_index.hpp"
+#include "csr_graph.hpp"
+#include "cut_dendrogram.hpp"
+#include "flow_telemetry.hpp"
+#include "graph_reduction.hpp"
 #include "mtx_reader.hpp"
+#include "push_relabel.hpp"
+#include "stoer_wagner.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
+// MaxFlow is the s-t min cut solver used by both Gomory-Hu constructions:
+// push_relabel (the default), lemon_preflow, dinic, boykov_kolmogorov or
+// pseudoflow. A solver is default constructible and has
+//   void run(csr_graph const& g, int s, int t);
+//   flow_type flow_value() const;
+//   bool min_cut(int u) const;  // u is on the source side
+//   std::vector<std::uint64_t> const& source_side() const;
+// One solver is kept per thread.
+template <typename MaxFlow = push_relabel>
 class k_min_cut
 {
     using ListGraph = lemon::ListGraph;
@@ -17,11 +40,544 @@ class k_min_cut
     ListGraph const& _graph;
     ListGraph::EdgeMap<int> const& _weights;
 
+    // The input graph in CSR layout, built by the constructor, and rebuilt
+    // by the updates. CSR node i is _nodes[i]. All flows and traversals run
+    // on it.
+    csr_graph _csr;
+    std::vector<ListGraph::Node> _nodes;
+    // The CSR node of each graph node, by id
+    std::vector<int> _csr_index;
+    // The arc u->v of _csr of each edge, by u * n + v with u < v, once the
+    // graph has been updated
+    std::unordered_map<std::uint64_t, int> _arcs;
+
     // The Gomory-Hu tree is encoded in the _p (predecessor) and _fl (min flow) maps as follows:
     // "The edges of T are the final pairs (i,p[i]) for from 2 to n, and edge (i,p[i]) has value fl(i)."
+    // Only run_gomory_hu writes them: the other constructions and the
+    // updates leave them as they were, and keep the tree in _tree.
+
+    // Nodes of degree 1 and 2 are taken out before the tree is built, and
+    // put back into it afterwards, if _reduce is set
+    bool _reduce = false;
+    bool _reduced = false;
+    graph_reduction _reduction;
+
+    // The predecessor map, by node of flow_graph() (-1 for the root)
+    std::vector<int> _p;
+
+    // Number of threads used to build the Gomory-Hu tree
+    unsigned _n_threads = 1;
+
+    // One max-flow engine per thread. Their workspaces are kept from one
+    // flow to the next, and from one tree construction to the next.
+    std::vector<MaxFlow> _engines;
+    // Samples of the flows of the last tree construction
+    flow_telemetry _telemetry;
+
+    // Min cut queries on the tree, by CSR node, built with the tree
+    cut_query_index _cut_index;
+    // Sums of the k smallest tree flows, for k = 0..n-1, built with the tree
+    std::vector<long long> _smallest_sums{0};
+    // The min k-cuts of every k, by CSR node, built with the tree
+    cut_dendrogram _dendrogram;
+    // The edges of the tree, by CSR node
+    std::vector<csr_graph::edge> _tree_edges;
+
+    // The result of a flow computed ahead of its turn in Gusfield's algorithm
+    struct speculation
+    {
+        // The s the flow was computed for
+        int s = -1;
+        // The t the flow was computed against
+        int t = -1;
+        int flow = 0;
+        // By CSR node, as a bitset (see push_relabel::source_side)
+        std::vector<std::uint64_t> source_side;
+        // Number of nodes on the source side
+        int cut_size = 0;
+        flow_sample sample;
+
+        bool in_cut(int i) const
+        {
+            return (source_side[i / 64] >> (i % 64)) & 1;
+        }
+    };
+
+    // Index of the lowest set bit of a nonzero word
+    static int lowest_bit(std::uint64_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(bits);
+#else
+        int b = 0;
+        while (!((bits >> b) & 1))
+            ++b;
+        return b;
+#endif
+    }
+
+    // Times, hardware counts and number of flows of a run of gusfield. With
+    // a pool, the counts of the flows are those of its workers, and the
+    // counts of the commits those of the calling thread, which also hands
+    // out the batches; without one, the counts of the flows include the
+    // commits.
+    struct gusfield_stats
+    {
+        double time_min_cut = 0;
+        double time_relabel = 0;
+        perf_sample counts_min_cut;
+        perf_sample counts_relabel;
+        std::size_t n_flows = 0;
+    };
+
+    // Gusfield's algorithm on graph: p[i] is the parent of node i in the
+    // tree (-1 for the root), and fl[i] the flow on the edge to it. The
+    // flows run on the threads of pool if there is one, and otherwise on the
+    // calling thread, which is worker. Flows are recorded in the telemetry
+    // by node of flow_graph(): nodes[i] for node i, if nodes is given.
+    void gusfield(csr_graph const& graph, std::vector<int>& p,
+        std::vector<int>& fl, thread_pool* pool, unsigned worker,
+        gusfield_stats& stats, std::vector<int> const* nodes = nullptr)
+    {
+        // Nodes are processed in order. The first node is the root.
+        int const n = graph.n_nodes();
+        int const root = 0;
+
+        // Initialize the predecessor map
+        p.assign(n, root);
+        fl.assign(n, 0);
+        if (n > 0)
+        {
+            p[root] = -1;
+            fl[root] = std::numeric_limits<int>::max();
+        }
+
+        // The children of each node in the tree of p, as intrusive doubly
+        // linked lists with their sizes, so that re-pointing the children of
+        // t on the s side looks at the children of t or at the s side,
+        // whichever is smaller, instead of at every node
+        std::vector<int> first_child(n, -1);
+        std::vector<int> next_sibling(n, -1);
+        std::vector<int> prev_sibling(n, -1);
+        std::vector<int> n_children(n, 0);
+        auto link = [&](int i, int parent) {
+            p[i] = parent;
+            ++n_children[parent];
+            prev_sibling[i] = -1;
+            next_sibling[i] = first_child[parent];
+            if (first_child[parent] != -1)
+                prev_sibling[first_child[parent]] = i;
+            first_child[parent] = i;
+        };
+        auto unlink = [&](int i) {
+            --n_children[p[i]];
+            if (prev_sibling[i] != -1)
+                next_sibling[prev_sibling[i]] = next_sibling[i];
+            else
+                first_child[p[i]] = next_sibling[i];
+            if (next_sibling[i] != -1)
+                prev_sibling[next_sibling[i]] = prev_sibling[i];
+        };
+        for (int i = n - 1; i > root; --i)
+        {
+            link(i, root);
+        }
+
+        // Speculative Gusfield: a batch of the next unprocessed nodes computes
+        // its flows concurrently, using t = p[s] as it is at the start of the
+        // batch. Results are then committed in order, for as long as p[s]
+        // still equals the t that was used. A stale result is recomputed in
+        // the next batch. This gives exactly the tree of the serial algorithm.
+        // Each worker runs the flows on its own engine. The engines are
+        // deterministic, so a flow gives the same cut on any worker.
+        // Without a pool, batches have one node and the flows run here.
+        int const batch_size = pool ? static_cast<int>(_n_threads) : 1;
+        std::vector<speculation> window(batch_size);
+
+        // The counters are read once per worker for the whole run, not
+        // per flow
+        bool const counting = perf_counters::enabled();
+        std::vector<perf_sample> worker_counts(pool ? pool->size() : 0);
+        if (pool && counting)
+        {
+            pool->for_each_worker([&](unsigned w) {
+                worker_counts[w] = perf_counters::this_thread().read();
+            });
+        }
+        perf_scope p_caller;
+
+        int next = 1;
+        while (next < n)
+        {
+            int batch_end = std::min(n, next + batch_size);
+
+            timer t_min_cut;
+
+            // Collect the nodes whose speculation is missing or stale
+            std::vector<int> todo;
+            for (int s = next; s < batch_end; ++s)
+            {
+                speculation const& spec = window[s % batch_size];
+                if (spec.s != s || spec.t != p[s])
+                {
+                    todo.push_back(s);
+                }
+            }
+
+            auto compute = [&](std::size_t j, unsigned worker) {
+                int s = todo[j];
+                speculation& spec = window[s % batch_size];
+                spec.s = s;
+                spec.t = p[s];
+
+                MaxFlow& engine = _engines[worker];
+                flow_probe<MaxFlow> probe(engine);
+                engine.run(graph, s, spec.t);
+                spec.sample = probe.finish(s, spec.t);
+
+                spec.flow = static_cast<int>(engine.flow_value());
+                spec.source_side = engine.source_side();
+                spec.cut_size = cut_side_size(spec.source_side);
+            };
+            if (pool)
+                pool->parallel_for(todo.size(), compute);
+            else if (!todo.empty())
+                compute(0, worker);
+            stats.n_flows += todo.size();
+
+            stats.time_min_cut += t_min_cut.tick();
+
+            timer t_relabel;
+
+            // Commit, in order, every speculation that is still valid.
+            // The first one always is, since all nodes before it are committed.
+            while (next < batch_end && window[next % batch_size].t == p[next])
+            {
+                speculation const& spec = window[next % batch_size];
+                int s = next;
+                int t = spec.t;
+                timer t_commit;
+
+                fl[s] = spec.flow;
+
+                // The nodes i with p[i] = t are the children of t. On the
+                // first flows t is the root, the parent of every node, and
+                // the s side is usually small: walk its bits instead.
+                if (n_children[t] <= spec.cut_size)
+                {
+                    for (int i = first_child[t], next_i; i != -1; i = next_i)
+                    {
+                        next_i = next_sibling[i];
+                        if (i != s && spec.in_cut(i))
+                        {
+                            unlink(i);
+                            link(i, s);
+                        }
+                    }
+                }
+                else
+                {
+                    for (std::size_t w = 0; w < spec.source_side.size(); ++w)
+                    {
+                        for (std::uint64_t bits = spec.source_side[w];
+                             bits != 0; bits &= bits - 1)
+                        {
+                            int i = static_cast<int>(w * 64) +
+                                lowest_bit(bits);
+                            if (i != s && p[i] == t)
+                            {
+                                unlink(i);
+                                link(i, s);
+                            }
+                        }
+                    }
+                }
+                if (p[t] != -1 && spec.in_cut(p[t]))
+                {
+                    int parent = p[t];
+                    unlink(s);
+                    link(s, parent);
+                    unlink(t);
+                    link(t, s);
+                    fl[s] = fl[t];
+                    fl[t] = spec.flow;
+                }
+
+                if constexpr (flow_telemetry::enabled)
+                {
+                    flow_sample sample = spec.sample;
+                    sample.time_relabel = t_commit.tick();
+                    if (nodes)
+                    {
+                        sample.s = (*nodes)[sample.s];
+                        sample.t = (*nodes)[sample.t];
+                    }
+                    _telemetry.record(worker, sample);
+                }
+
+                ++next;
+            }
+
+            stats.time_relabel += t_relabel.tick();
+        }
+
+        if (!pool)
+        {
+            stats.counts_min_cut += p_caller.tick();
+            return;
+        }
+        stats.counts_relabel += p_caller.tick();
+        if (counting)
+        {
+            pool->for_each_worker([&](unsigned w) {
+                worker_counts[w] =
+                    perf_counters::this_thread().read() - worker_counts[w];
+            });
+            for (perf_sample const& counts : worker_counts)
+            {
+                stats.counts_min_cut += counts;
+            }
+        }
+    }
+
+    // The graph the flows run on: the core left by the reduction, or the
+    // whole graph
+    csr_graph const& flow_graph()
+    {
+        if (!_reduce)
+            return _csr;
+        if (!_reduced)
+        {
+            timer t_reduction;
+            _reduction.reduce(_csr);
+            _reduced = true;
+            global_json_logger.add("reduction_time", t_reduction.tick());
+            global_json_logger.add(
+                "reduction_n_core_nodes", _reduction.core().n_nodes());
+        }
+        return _reduction.core();
+    }
+
+    // The CSR node of node i of flow_graph()
+    int csr_node(int i) const
+    {
+        return _reduce ? _reduction.original(i) : i;
+    }
+
+    // The graph node id of node i of flow_graph()
+    int flow_graph_id(int i) const
+    {
+        return _graph.id(_nodes[csr_node(i)]);
+    }
+
+    // Populate _tree from the edges of a Gomory-Hu tree of flow_graph(),
+    // weighted by flow, or of _csr if expand is false. Tree node i is CSR
+    // node i.
+    void build_tree(std::vector<csr_graph::edge> edges, bool expand = true)
+    {
+        if (_reduce && expand)
+        {
+            timer t_expand;
+            edges = _reduction.expand(edges);
+            global_json_logger.add("reduction_time_expand", t_expand.tick());
+            global_json_logger.add(
+                "reduction_n_split_flows", _reduction.n_split_flows());
+        }
+
+        // The tree is an undirected graph with the same nodes as the original graph
+        _tree.clear();
+        for (ListGraph::Node n : _nodes)
+        {
+            ListGraph::Node m = _tree.addNode();
+            _tree_labels[m] = _graph.id(n);
+        }
+        for (csr_graph::edge const& e : edges)
+        {
+            ListGraph::Edge f =
+                _tree.addEdge(_tree.nodeFromId(e.u), _tree.nodeFromId(e.v));
+            _tree_flows[f] = e.weight;
+        }
 
-    // The predecessor map
-    ListGraph::NodeMap<ListGraph::Node> _p;
+        _tree_edges = edges;
+
+        timer t_index;
+        _cut_index.build(static_cast<int>(_nodes.size()), edges);
+        _dendrogram.build(static_cast<int>(_nodes.size()), edges);
+        std::vector<int> flows;
+        flows.reserve(edges.size());
+        for (csr_graph::edge const& e : edges)
+        {
+            flows.push_back(e.weight);
+        }
+        std::sort(flows.begin(), flows.end());
+        _smallest_sums.assign(1, 0);
+        for (int f : flows)
+        {
+            _smallest_sums.push_back(_smallest_sums.back() + f);
+        }
+        global_json_logger.add("cut_index_time", t_index.tick());
+    }
+
+    // Change the weight of the edge between CSR nodes a and b by delta,
+    // adding or removing the edge as needed, and bring the tree up to date.
+    // Only the tree edges whose cut can change are recomputed, by the
+    // supernode splits of run_gomory_hu_2 from the tree of the other edges:
+    // - Growing the edge raises every cut between a and b, and no other.
+    //   The tree edges off the a-b tree path keep their cuts, which are
+    //   still minimal, and those on the path are recomputed.
+    // - Shrinking the edge lowers the cuts between a and b by the same
+    //   amount. The tree edges on the path keep their cuts, which are still
+    //   minimal, with their flows lowered. An edge off the path keeps its
+    //   cut unless a cut between a and b drops below its flow, which needs
+    //   a flow above the old min a-b cut minus the decrease.
+    void update_weight(int a, int b, int delta)
+    {
+        timer t_total;
+
+        int const n = _csr.n_nodes();
+        if (a == b)
+            return;
+        if (a > b)
+            std::swap(a, b);
+
+        // An edge whose weight changes keeps its arc. Adding or removing one
+        // rebuilds the CSR graph.
+        auto key = [n](int u, int v) {
+            return std::uint64_t(u) * std::uint64_t(n) + std::uint64_t(v);
+        };
+        auto index_arcs = [&] {
+            _arcs.clear();
+            for (int u = 0; u < n; ++u)
+            {
+                for (int arc = _csr.begin(u); arc < _csr.end(u); ++arc)
+                {
+                    if (u < _csr.target(arc))
+                        _arcs.emplace(key(u, _csr.target(arc)), arc);
+                }
+            }
+        };
+        if (_arcs.empty())
+            index_arcs();
+        auto e = _arcs.find(key(a, b));
+        int const arc = e == _arcs.end() ? -1 : e->second;
+        int const weight = arc == -1 ? 0 : _csr.capacity(arc);
+        delta = std::max(delta, -weight);
+        if (delta == 0)
+            return;
+        if (arc != -1 && weight + delta > 0)
+            _csr.set_capacity(arc, weight + delta);
+        else
+        {
+            std::vector<csr_graph::edge> edges;
+            edges.reserve(_arcs.size() + 1);
+            for (int u = 0; u < n; ++u)
+            {
+                for (int f = _csr.begin(u); f < _csr.end(u); ++f)
+                {
+                    if (u < _csr.target(f) && f != arc)
+                        edges.push_back({u, _csr.target(f), _csr.capacity(f)});
+                }
+            }
+            if (arc == -1)
+                edges.push_back({a, b, delta});
+            _csr.build(n, edges);
+            index_arcs();
+        }
+        // The reduction is of the old graph
+        _reduced = false;
+
+        // Without a tree, there is nothing to update
+        if (n < 2 || _tree_edges.size() + 1 != std::size_t(n))
+            return;
+
+        // The nodes of the tree path from b to a, marked by a walk up the
+        // tree rooted at a
+        csr_graph tree;
+        tree.build(n, _tree_edges);
+        std::vector<int> parent(n, -1);
+        std::vector<int> stack{a};
+        parent[a] = a;
+        while (!stack.empty())
+        {
+            int u = stack.back();
+            stack.pop_back();
+            for (int arc = tree.begin(u); arc < tree.end(u); ++arc)
+            {
+                if (parent[tree.target(arc)] == -1)
+                {
+                    parent[tree.target(arc)] = u;
+                    stack.push_back(tree.target(arc));
+                }
+            }
+        }
+        std::vector<char> on_path(n, 0);
+        for (int u = b; u != a; u = parent[u])
+        {
+            on_path[u] = 1;
+        }
+        long long const path_min = _cut_index.min_cut(a, b);
+
+        // Merge the nodes across the tree edges to recompute
+        std::vector<int> root(n);
+        std::iota(root.begin(), root.end(), 0);
+        auto find = [&](int u) {
+            while (root[u] != u)
+            {
+                root[u] = root[root[u]];
+                u = root[u];
+            }
+            return u;
+        };
+        std::vector<csr_graph::edge> kept;
+        for (csr_graph::edge f : _tree_edges)
+        {
+            // The edge to the parent of the child end is on the path if the
+            // child is
+            int child = parent[f.u] == f.v ? f.u : f.v;
+            bool keep;
+            if (delta > 0)
+                keep = !on_path[child];
+            else if (on_path[child])
+            {
+                f.weight += delta;
+                keep = true;
+            }
+            else
+                keep = f.weight <= path_min + delta;
+
+            if (keep)
+                kept.push_back(f);
+            else
+                root[find(f.u)] = find(f.v);
+        }
+
+        // One supernode per merged set, joined by the kept edges
+        supernode_tree st;
+        st.next.assign(n, -1);
+        std::vector<std::vector<int>> members(n);
+        for (int u = 0; u < n; ++u)
+        {
+            members[find(u)].push_back(u);
+        }
+        std::vector<ListGraph::Node> supernode(n, INVALID);
+        for (int u = 0; u < n; ++u)
+        {
+            if (!members[u].empty())
+                supernode[u] = st.add(members[u]);
+        }
+        for (csr_graph::edge const& f : kept)
+        {
+            ListGraph::Edge edge = st.tree.addEdge(
+                supernode[find(f.u)], supernode[find(f.v)]);
+            st.flows[edge] = f.weight;
+        }
+
+        split_stats stats = split_supernodes(_csr, st);
+        build_tree(st.edges(), false);
+
+        global_json_logger.add("update_time_total", t_total.tick());
+        global_json_logger.add("update_n_flows", stats.n_flows);
+    }
 
 public:
     // The min flow map
@@ -36,12 +592,34 @@ public:
     k_min_cut(ListGraph const& graph, ListGraph::EdgeMap<int> const& weights)
       : _graph(graph)
       , _weights(weights)
-      , _p(graph)
       , _fl(graph)
       , _tree()
       , _tree_flows(_tree)
       , _tree_labels(_tree)
     {
+        _csr.build(_graph, _weights, _nodes);
+        _csr_index.assign(_graph.maxNodeId() + 1, -1);
+        for (std::size_t i = 0; i < _nodes.size(); ++i)
+        {
+            _csr_index[_graph.id(_nodes[i])] = static_cast<int>(i);
+        }
+        _engines.resize(_n_threads);
+    }
+
+    // Set the number of threads used to build the tree.
+    // The tree does not depend on it.
+    void set_threads(unsigned n_threads)
+    {
+        _n_threads = std::max(1u, n_threads);
+        _engines.resize(_n_threads);
+    }
+
+    // Take the nodes of degree 1 and 2 out of the graph before building the
+    // tree (see graph_reduction). The tree is the same up to the choice
+    // between equal min cuts, and costs fewer flows.
+    void set_reduction(bool reduce)
+    {
+        _reduce = reduce;
     }
 
     void run_gomory_hu()
@@ -64,113 +642,202 @@ public:
         end;
     end;
 */
-        double time_min_cut = 0;
-        double time_relabel = 0;
-        double time_total = 0;
-
         timer t_total;
 
-        // Choose a root node
-        ListGraph::NodeIt root(_graph);
-
-        // Initialize the predecessor map
-        for (ListGraph::NodeIt n(_graph); n != INVALID; ++n)
+        csr_graph const& graph = flow_graph();
+        int const n = graph.n_nodes();
+        std::vector<int> fl;
+        gusfield_stats stats;
+        _telemetry.start(_n_threads, n);
+        if (_n_threads > 1)
         {
-            _p[n] = root;
+            thread_pool pool(_n_threads);
+            gusfield(graph, _p, fl, &pool, 0, stats);
+        }
+        else
+        {
+            gusfield(graph, _p, fl, nullptr, 0, stats);
         }
-        _p[root] = INVALID;
-        _fl[root] = std::numeric_limits<int>::max();
-        ;
 
-        for (ListGraph::NodeIt s(_graph); s != INVALID; ++s)
+        // The edges of the tree are (i, p[i]) with weight fl[i]
+        std::vector<csr_graph::edge> tree_edges;
+        for (int i = 0; i < n; ++i)
         {
-            if (s == root)
-                continue;
+            _fl[_nodes[csr_node(i)]] = fl[i];
+            if (_p[i] != -1)
+                tree_edges.push_back({i, _p[i], fl[i]});
+        }
+        build_tree(tree_edges);
 
-            timer t_min_cut;
+        double time_total = t_total.tick();
+
+        // Write times to json log
+        global_json_logger.add("gh_time_min_cut", stats.time_min_cut);
+        global_json_logger.add("gh_time_relabel", stats.time_relabel);
+        global_json_logger.add_counts("gh_min_cut", stats.counts_min_cut);
+        global_json_logger.add_counts("gh_relabel", stats.counts_relabel);
+        global_json_logger.add("gh_time_total", time_total);
+        global_json_logger.add("gh_threads", _n_threads);
+        global_json_logger.add("gh_n_flows", stats.n_flows);
+        _telemetry.log("gh", [&](int i) { return flow_graph_id(i); });
+    }
 
-            ListGraph::Node t = _p[s];
+    // Gusfield's algorithm on each biconnected component (block) of the
+    // graph. A min cut between two nodes of a block can always be chosen to
+    // leave the other blocks whole, since they hang from the block by single
+    // nodes. So the trees of the blocks, glued at the articulation points,
+    // make a Gomory-Hu tree of the graph. Connected components are joined by
+    // edges with flow 0, their actual cut.
+    //
+    // The blocks are independent tasks. The largest block, if it is a large
+    // part of the graph, is built first with all threads.
+    void run_gomory_hu_blocks()
+    {
+        timer t_total;
 
-            lemon::Preflow<ListGraph, ListGraph::EdgeMap<int>> min_cut(
-                _graph, _weights, s, t);
-            min_cut.run();
+        csr_graph const& graph = flow_graph();
+        int const n = graph.n_nodes();
 
-            time_min_cut += t_min_cut.tick();
+        timer t_blocks;
+        block_decomposition blocks;
+        blocks.run(graph);
+        int const n_blocks = blocks.n_blocks();
+        double time_blocks = t_blocks.tick();
 
-            _fl[s] = min_cut.flowValue();
+        // Largest first
+        std::vector<int> order(n_blocks);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return blocks.block_size(a) > blocks.block_size(b);
+        });
 
-            timer t_relabel;
+        // Scratch data of each worker, reused from one block to the next
+        struct block_worker
+        {
+            // Node of the block of each node of the graph, or -1
+            std::vector<int> local;
+            // Node of the graph of each node of the block
+            std::vector<int> nodes;
+            std::vector<csr_graph::edge> edges;
+            csr_graph graph;
+            std::vector<int> p;
+            std::vector<int> fl;
+            gusfield_stats stats;
+        };
+        std::vector<block_worker> workers(_n_threads);
+        for (auto& w : workers)
+        {
+            w.local.assign(n, -1);
+        }
+        std::vector<std::vector<csr_graph::edge>> block_trees(n_blocks);
+        _telemetry.start(_n_threads, n);
+
+        auto solve = [&](int block, thread_pool* pool, unsigned worker) {
+            block_worker& w = workers[worker];
+            w.nodes.clear();
+            w.edges.clear();
+            for (auto e = blocks.block_begin(block); e != blocks.block_end(block);
+                 ++e)
+            {
+                for (int u : {e->u, e->v})
+                {
+                    if (w.local[u] == -1)
+                    {
+                        w.local[u] = static_cast<int>(w.nodes.size());
+                        w.nodes.push_back(u);
+                    }
+                }
+                w.edges.push_back({w.local[e->u], w.local[e->v], e->weight});
+            }
 
-            for (ListGraph::NodeIt i(_graph); i != INVALID; ++i)
+            std::vector<csr_graph::edge>& tree = block_trees[block];
+            if (w.nodes.size() == 2)
             {
-                if (i != s && min_cut.minCut(i) && _p[i] == t)
+                // A bridge, or parallel edges: no flow needed
+                int flow = 0;
+                for (csr_graph::edge const& e : w.edges)
                 {
-                    _p[i] = s;
+                    flow += e.weight;
                 }
+                tree.push_back({w.nodes[0], w.nodes[1], flow});
             }
-            if (_p[t] != INVALID && min_cut.minCut(_p[t]))
+            else
             {
-                _p[s] = _p[t];
-                _p[t] = s;
-                _fl[s] = _fl[t];
-                _fl[t] = min_cut.flowValue();
+                w.graph.build(static_cast<int>(w.nodes.size()), w.edges);
+                gusfield(
+                    w.graph, w.p, w.fl, pool, worker, w.stats, &w.nodes);
+                for (std::size_t i = 0; i < w.nodes.size(); ++i)
+                {
+                    if (w.p[i] != -1)
+                    {
+                        tree.push_back(
+                            {w.nodes[i], w.nodes[w.p[i]], w.fl[i]});
+                    }
+                }
             }
 
-            time_relabel += t_relabel.tick();
-        }
-
-        // Create the Gomory-Hu tree. The tree is an undirected graph with the same nodes as the original graph
-        // and edges (i, p[i]) with weight fl[i].
-        // Making it into a graph to make it easier to traverse, however in principle _p is enough to represent the tree.
-        // An important property here is that each node has a single parent (except the root node which has none).
-        _tree.clear();
-        // Turns out you can't just copy a graph in this library while keeping the same node/edge ids
-        // We create a map to map the nodes in the original graph to the nodes in the tree
-        ListGraph::NodeMap<ListGraph::Node> node_map(_graph);
-        for (ListGraph::NodeIt n(_graph); n != INVALID; ++n)
-        {
-            ListGraph::Node m = _tree.addNode();
-            node_map[n] = m;
-            _tree_labels[m] = _graph.id(n);
-        }
+            for (int u : w.nodes)
+            {
+                w.local[u] = -1;
+            }
+        };
 
-        // Now add the edges
-        for (ListGraph::NodeIt n(_graph); n != INVALID; ++n)
         {
-            if (_p[n] != INVALID)
+            thread_pool pool(_n_threads);
+            std::size_t first = 0;
+            if (n_blocks > 0 && _n_threads > 1 &&
+                std::size_t(blocks.block_size(order[0])) * _n_threads >=
+                    std::size_t(graph.n_arcs() / 2))
             {
-                ListGraph::Node m = node_map[n];
-                ListGraph::Node p = node_map[_p[n]];
-                ListGraph::Edge e = _tree.addEdge(m, p);
-                _tree_flows[e] = _fl[n];
+                solve(order[0], &pool, 0);
+                first = 1;
             }
+            pool.parallel_for(n_blocks - first,
+                [&](std::size_t j, unsigned worker) {
+                    solve(order[first + j], nullptr, worker);
+                });
         }
 
-        time_total = t_total.tick();
-
-        // Write times to json log
-        global_json_logger.add("gh_time_min_cut", time_min_cut);
-        global_json_logger.add("gh_time_relabel", time_relabel);
-        global_json_logger.add("gh_time_total", time_total);
-    }
-
-    // DFS Visitor that invokes some callable on reaching a node
-    template <typename F>
-    class MyVisitor : public lemon::DfsVisitor<ListGraph>
-    {
-        F _f;
-
-    public:
-        MyVisitor(F f)
-          : _f(f)
+        std::vector<csr_graph::edge> tree_edges;
+        for (auto const& tree : block_trees)
         {
+            tree_edges.insert(tree_edges.end(), tree.begin(), tree.end());
         }
+        for (int c = 1; c < blocks.n_components(); ++c)
+        {
+            tree_edges.push_back(
+                {blocks.component_root(c), blocks.component_root(0), 0});
+        }
+        build_tree(tree_edges);
+
+        double time_total = t_total.tick();
 
-        void reach(const Node& node)
+        // Times of the parallel phases are summed over workers
+        gusfield_stats stats;
+        for (auto const& w : workers)
         {
-            _f(node);
+            stats.time_min_cut += w.stats.time_min_cut;
+            stats.time_relabel += w.stats.time_relabel;
+            stats.counts_min_cut += w.stats.counts_min_cut;
+            stats.counts_relabel += w.stats.counts_relabel;
+            stats.n_flows += w.stats.n_flows;
         }
-    };
+
+        // Write times to json log
+        global_json_logger.add("blocks_time_decomposition", time_blocks);
+        global_json_logger.add("blocks_n_blocks", n_blocks);
+        global_json_logger.add("blocks_n_components", blocks.n_components());
+        global_json_logger.add("blocks_largest",
+            n_blocks > 0 ? blocks.block_size(order[0]) : 0);
+        global_json_logger.add("gh_time_min_cut", stats.time_min_cut);
+        global_json_logger.add("gh_time_relabel", stats.time_relabel);
+        global_json_logger.add_counts("gh_min_cut", stats.counts_min_cut);
+        global_json_logger.add_counts("gh_relabel", stats.counts_relabel);
+        global_json_logger.add("gh_time_total", time_total);
+        global_json_logger.add("gh_threads", _n_threads);
+        global_json_logger.add("gh_n_flows", stats.n_flows);
+        _telemetry.log("gh", [&](int i) { return flow_graph_id(i); });
+    }
 
     static void print_graph(
         ListGraph const& g, ListGraph::EdgeMap<int> const& weights)
@@ -187,16 +854,19 @@ public:
         }
     }
 
+    // Print a supernode tree, whose members are stored as intrusive lists:
+    // head[n] is the id of the first member of supernode n, and next[i]
+    // the id of the member after i (-1 at the end of the list).
     static void print_supergraph(ListGraph const& g,
-        ListGraph::NodeMap<std::vector<ListGraph::Node>> const& supernodes,
+        ListGraph::NodeMap<int> const& head, std::vector<int> const& next,
         ListGraph::EdgeMap<int> const& weights)
     {
         for (ListGraph::NodeIt n(g); n != INVALID; ++n)
         {
             std::cout << "Node " << g.id(n) << ": ";
-            for (ListGraph::Node m : supernodes[n])
+            for (int m = head[n]; m != -1; m = next[m])
             {
-                std::cout << g.id(m) << " ";
+                std::cout << m << " ";
             }
             std::cout << std::endl;
         }
@@ -207,256 +877,408 @@ public:
         }
     }
 
-    void run_gomory_hu_2()
+    // The state of the original Gomory-Hu algorithm: a tree of supernodes,
+    // whose edges are min cuts between nodes of their two sides. The
+    // contents of each supernode are an intrusive list of graph nodes: the
+    // first member, the number of members, and the member after each node
+    // (-1 at the end of a list).
+    struct supernode_tree
     {
-        // This is the implementation of the original Gomory-Hu algorithm
-        // It is probably less efficient than Gusfield's algorithm, but it is easier to prove its correctness.
+        ListGraph tree;
+        ListGraph::EdgeMap<int> flows{tree};
+        ListGraph::NodeMap<int> head{tree};
+        ListGraph::NodeMap<int> size{tree};
+        std::vector<int> next;
+
+        // Add a supernode with the given members
+        ListGraph::Node add(std::vector<int> const& members)
+        {
+            ListGraph::Node sn = tree.addNode();
+            head[sn] = -1;
+            size[sn] = static_cast<int>(members.size());
+            for (auto m = members.rbegin(); m != members.rend(); ++m)
+            {
+                next[*m] = head[sn];
+                head[sn] = *m;
+            }
+            return sn;
+        }
 
-        // The Gomory-Hu Tree begins as a single supernode containing all graph vertices
-        // Each iteration of the algorithm is as follows:
-        // 1. Select a pair of vertices s-t in a supernode S
-        // 2. Find the connected components in T afte removing the supernode, and contract all nodes in each component
-        // 3. Compute the minimum cut between s and t in the contracted graph, creating two new supernodes, S1 and S2
-        // 4. Add S1 and S2 to the Gomory-Hu Tree, with an edge between them with the value of the minimum cut
-        // 5. Connect neighbors of S to S1 and S2, depending on which side of the cut they are in
-        // 6. Repeat until all supernodes contain a single vertex
+        // The edges of the tree, once every supernode holds a single node
+        std::vector<csr_graph::edge> edges() const
+        {
+            std::vector<csr_graph::edge> result;
+            for (ListGraph::EdgeIt e(tree); e != INVALID; ++e)
+            {
+                result.push_back(
+                    {head[tree.u(e)], head[tree.v(e)], flows[e]});
+            }
+            return result;
+        }
+    };
 
+    // Times, hardware counts and number of flows of a run of
+    // split_supernodes. The counts are those of the whole run, contractions
+    // included.
+    struct split_stats
+    {
         double time_min_cut = 0;
         double time_contraction = 0;
-        double time_total = 0;
+        perf_sample counts;
+        std::size_t n_flows = 0;
+    };
 
-        timer t_total;
+    // Split the supernodes of st, whose members are nodes of graph, until
+    // each holds a single node. See run_gomory_hu_2.
+    split_stats split_supernodes(csr_graph const& graph, supernode_tree& st)
+    {
+        int const n_nodes = graph.n_nodes();
+        // Guards st
+        std::shared_mutex mutex;
 
-        // The Gomory-Hu Tree
-        ListGraph gh_tree;
-        // The min cut values
-        ListGraph::EdgeMap<int> gh_tree_flows(gh_tree);
-        // The contents of each supernode
-        ListGraph::NodeMap<std::vector<ListGraph::Node>> gh_tree_supernodes(
-            gh_tree);
+        // Scratch data of each worker, reused from one split to the next
+        struct split_worker
+        {
+            // Contracted node of each node
+            std::vector<int> label;
+            // Maps temporary labels to canonical ones
+            std::vector<int> canonical;
+            // DFS marks on st.tree, by id. A node is marked if it holds stamp.
+            std::vector<unsigned> mark;
+            unsigned stamp = 0;
+            std::vector<ListGraph::Node> stack;
+            contracted_graph contraction;
+            double time_min_cut = 0;
+            double time_contraction = 0;
+            std::size_t n_flows = 0;
+        };
+        std::vector<split_worker> workers(_n_threads);
+        for (auto& w : workers)
+        {
+            w.label.assign(n_nodes, -1);
+        }
 
-        // Supernodes with more than one vertex to process
-        std::stack<ListGraph::Node> supernode_stack;
+        // The workers add their counts to those of this thread when the pool
+        // is destroyed, once for the whole run
+        perf_scope p_split;
+        std::unique_ptr<thread_pool> pool =
+            std::make_unique<thread_pool>(_n_threads);
 
-        {
-            // Create the initial supernode, containing all nodes
-            ListGraph::Node initial_sn = gh_tree.addNode();
-            gh_tree_supernodes[initial_sn].clear();
-            for (ListGraph::NodeIt n(_graph); n != INVALID; ++n)
-            {
-                gh_tree_supernodes[initial_sn].push_back(n);
-            }
+        std::function<void(ListGraph::Node, unsigned)> split;
+        split = [&](ListGraph::Node supernode, unsigned worker) {
+            split_worker& w = workers[worker];
 
-            supernode_stack.push(initial_sn);
-        }
+            timer t_contraction;
 
-        while (!supernode_stack.empty())
-        {
-            // Grab some supernode from stack
-            ListGraph::Node supernode = supernode_stack.top();
-            supernode_stack.pop();
+            // Only this task changes the member list of the supernode
+            int head;
+            int n_labels = 0;
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
 
-            //// Print for debug
-            //std::cout << "Gomory-Hu Tree: " << std::endl;
-            //print_supergraph(gh_tree, gh_tree_supernodes, gh_tree_flows);
+                head = st.head[supernode];
 
-            // Select two random vertices in the supernode
-            ListGraph::Node s = gh_tree_supernodes[supernode][0];
-            ListGraph::Node t = gh_tree_supernodes[supernode][1];
+                // Nodes of the supernode are not contracted
+                for (int n = head; n != -1; n = st.next[n])
+                {
+                    w.label[n] = n_labels++;
+                }
 
-            timer t_contraction;
+                // Every connected component of T minus the supernode is
+                // contracted into one node. Find them with a DFS from each
+                // neighbor of the supernode.
+                if (w.mark.size() <= std::size_t(st.tree.maxNodeId()))
+                {
+                    w.mark.resize(st.tree.maxNodeId() + 1, 0);
+                }
+                ++w.stamp;
+                w.mark[st.tree.id(supernode)] = w.stamp;
 
-            // Contraction step
-            // Create a copy of the original graph, which we need to perform node contractions
-            ListGraph contracted_graph;
-            ListGraph::EdgeMap<int> contracted_weights(contracted_graph);
-            ListGraph::NodeMap<ListGraph::Node> original_to_contracted(_graph);
-            lemon::GraphCopy<ListGraph, ListGraph> copy(
-                _graph, contracted_graph);
-            copy.edgeMap(_weights, contracted_weights);
-            copy.nodeRef(original_to_contracted);
-            copy.run();
-
-            //std::cout << "Contracted Graph (Before): " << std::endl;
-            //print_graph(contracted_graph, contracted_weights);
-
-            // A map from supernodes of tree to nodes of the contracted graph.
-            // We need this after the split, to connect the neighbors of the old supernode to the new supernodes.
-            ListGraph::NodeMap<ListGraph::Node> supernode_to_contracted(
-                gh_tree);
-
-            // Now we prepare the DFS algorithm to create the contracted graph
-            // We set the current supernode to visited. Then, running a DFS on any unvisited supernode will give us a connected component
-            // in the GH tree
-            ListGraph::NodeMap<bool> visited(gh_tree, false);
-            visited[supernode] = true;
-
-            ListGraph::Node contraction_node = INVALID;
-
-            MyVisitor visitor([&](ListGraph::Node const& visited_supernode) {
-                supernode_to_contracted[visited_supernode] =
-                    original_to_contracted[contraction_node];
-                for (ListGraph::Node n : gh_tree_supernodes[visited_supernode])
+                for (ListGraph::IncEdgeIt e(st.tree, supernode); e != INVALID;
+                     ++e)
                 {
-                    if (original_to_contracted[n] !=
-                        original_to_contracted[contraction_node])
+                    ListGraph::Node first = st.tree.oppositeNode(supernode, e);
+                    w.mark[st.tree.id(first)] = w.stamp;
+                    w.stack.push_back(first);
+                    while (!w.stack.empty())
                     {
-                        contracted_graph.contract(
-                            original_to_contracted[contraction_node],
-                            original_to_contracted[n]);
+                        ListGraph::Node sn = w.stack.back();
+                        w.stack.pop_back();
+                        for (int n = st.head[sn]; n != -1;
+                             n = st.next[n])
+                        {
+                            w.label[n] = n_labels;
+                        }
+                        for (ListGraph::IncEdgeIt f(st.tree, sn); f != INVALID;
+                             ++f)
+                        {
+                            ListGraph::Node next = st.tree.oppositeNode(sn, f);
+                            if (w.mark[st.tree.id(next)] != w.stamp)
+                            {
+                                w.mark[st.tree.id(next)] = w.stamp;
+                                w.stack.push_back(next);
+                            }
+                        }
                     }
+                    ++n_labels;
                 }
-            });
-
-            // Prepare the DFS algorithm
-            lemon::DfsVisit<ListGraph, decltype(visitor)> dfs(gh_tree, visitor);
-            dfs.init();
-            dfs.reachedMap(visited);
+            }
 
-            for (ListGraph::NodeIt sn(gh_tree); sn != INVALID; ++sn)
+            // Renumber contracted nodes by their smallest node, so that
+            // the contracted graph does not depend on the shape of st.tree
+            w.canonical.assign(n_labels, -1);
+            int n_contracted = 0;
+            for (int i = 0; i < n_nodes; ++i)
             {
-                if (visited[sn])
-                    continue;
-
-                // Aha, this must be some unexplored connected component
-                // Arbitrarily contract everything to the first node in this component
-                contraction_node = gh_tree_supernodes[sn][0];
-
-                dfs.addSource(sn);
-                dfs.start();
+                int& l = w.canonical[w.label[i]];
+                if (l < 0)
+                    l = n_contracted++;
+                w.label[i] = l;
             }
 
-            time_contraction += t_contraction.tick();
+            w.contraction.build(graph, w.label, n_contracted);
 
-            //std::cout << "Contracted Graph (After): " << std::endl;
-            //print_graph(contracted_graph, contracted_weights);
+            double time_contraction = t_contraction.tick();
+            w.time_contraction += time_contraction;
 
             timer t_min_cut;
 
-            // Finally, the contracted graph has been created. Run a min-cut algorithm on it
-            lemon::Preflow<ListGraph, ListGraph::EdgeMap<int>> min_cut(
-                contracted_graph, contracted_weights, original_to_contracted[s],
-                original_to_contracted[t]);
-            min_cut.run();
+            // Select two vertices in the supernode, and run a min-cut algorithm
+            // on the contracted graph
+            int s = head;
+            int t = st.next[head];
+            MaxFlow& min_cut = _engines[worker];
+            flow_probe<MaxFlow> probe(min_cut);
+            min_cut.run(w.contraction.graph(), w.label[s], w.label[t]);
+            ++w.n_flows;
+            if constexpr (flow_telemetry::enabled)
+            {
+                flow_sample sample = probe.finish(s, t);
+                sample.time_relabel = time_contraction;
+                _telemetry.record(worker, sample);
+            }
 
-            time_min_cut += t_min_cut.tick();
+            w.time_min_cut += t_min_cut.tick();
 
-            // Add the two new supernodes
-            ListGraph::Node supernode1 = gh_tree.addNode();
-            ListGraph::Node supernode2 = gh_tree.addNode();
+            timer t_publish;
 
-            // Distribute the nodes of the old supernode to the new supernodes according to the min-cut
-            gh_tree_supernodes[supernode1].clear();
-            gh_tree_supernodes[supernode2].clear();
-            for (ListGraph::Node n : gh_tree_supernodes[supernode])
             {
-                if (min_cut.minCut(original_to_contracted[n]))
-                {
-                    gh_tree_supernodes[supernode1].push_back(n);
-                }
-                else
+                std::unique_lock<std::shared_mutex> lock(mutex);
+
+                // Add the two new supernodes
+                ListGraph::Node supernode1 = st.tree.addNode();
+                ListGraph::Node supernode2 = st.tree.addNode();
+
+                // Distribute the nodes of the old supernode to the new supernodes according to the min-cut
+                st.head[supernode1] = -1;
+                st.head[supernode2] = -1;
+                st.size[supernode1] = 0;
+                st.size[supernode2] = 0;
+                for (int n = head, next; n != -1; n = next)
                 {
-                    gh_tree_supernodes[supernode2].push_back(n);
+                    next = st.next[n];
+                    ListGraph::Node sn =
+                        min_cut.min_cut(w.label[n]) ? supernode1 : supernode2;
+                    st.next[n] = st.head[sn];
+                    st.head[sn] = n;
+                    ++st.size[sn];
                 }
-            }
 
-            // Add an edge between the two supernodes with the value of the min-cut
-            ListGraph::Edge e = gh_tree.addEdge(supernode1, supernode2);
-            gh_tree_flows[e] = min_cut.flowValue();
+                // Add an edge between the two supernodes with the value of the min-cut
+                ListGraph::Edge e = st.tree.addEdge(supernode1, supernode2);
+                st.flows[e] = static_cast<int>(min_cut.flow_value());
 
-            // Connect neighbors of the supernode to the new supernodes
-            for (ListGraph::IncEdgeIt e(gh_tree, supernode); e != INVALID; ++e)
-            {
-                ListGraph::Node sn = gh_tree.oppositeNode(supernode, e);
-
-                if (sn == supernode1 || sn == supernode2)
-                    continue;
+                // Connect neighbors of the supernode to the new supernodes.
+                // A neighbor may have been split since we labelled the graph,
+                // but all its nodes are still in the same contracted node.
+                for (ListGraph::IncEdgeIt e(st.tree, supernode); e != INVALID;
+                     ++e)
+                {
+                    ListGraph::Node sn = st.tree.oppositeNode(supernode, e);
 
-                // See which side of the cut the corresponding node is in
-                auto contr = supernode_to_contracted[sn];
+                    if (sn == supernode1 || sn == supernode2)
+                        continue;
 
-                // Not a neighbor
-                if (contr == INVALID)
-                    continue;
+                    // See which side of the cut the corresponding node is in
+                    int contr = w.label[st.head[sn]];
 
-                if (min_cut.minCut(contr))
-                {
-                    ListGraph::Edge new_e = gh_tree.addEdge(sn, supernode1);
-                    gh_tree_flows[new_e] = gh_tree_flows[e];
+                    ListGraph::Edge new_e = st.tree.addEdge(
+                        sn, min_cut.min_cut(contr) ? supernode1 : supernode2);
+                    st.flows[new_e] = st.flows[e];
                 }
-                else
+
+                // Remove the current supernode from the tree
+                st.tree.erase(supernode);
+
+                // Split the new supernodes in turn
+                for (ListGraph::Node sn : {supernode1, supernode2})
                 {
-                    ListGraph::Edge new_e = gh_tree.addEdge(sn, supernode2);
-                    gh_tree_flows[new_e] = gh_tree_flows[e];
+                    if (st.size[sn] > 1)
+                    {
+                        pool->submit([&split, sn](unsigned worker) {
+                            split(sn, worker);
+                        });
+                    }
                 }
             }
 
-            // Add the new supernodes to the stack
-            if (gh_tree_supernodes[supernode1].size() > 1)
-            {
-                supernode_stack.push(supernode1);
-            }
-            if (gh_tree_supernodes[supernode2].size() > 1)
-            {
-                supernode_stack.push(supernode2);
-            }
+            w.time_contraction += t_publish.tick();
+        };
 
-            // Remove the current supernode from the tree
-            gh_tree.erase(supernode);
+        std::vector<ListGraph::Node> initial;
+        for (ListGraph::NodeIt sn(st.tree); sn != INVALID; ++sn)
+        {
+            if (st.size[sn] > 1)
+                initial.push_back(sn);
         }
-
-        // Phew.. that was a lot of code. Finally, populate the class data members
-        _tree.clear();
-
-        ListGraph::NodeMap<ListGraph::Node> final_node_map(gh_tree);
-
-        for (ListGraph::NodeIt s(gh_tree); s != INVALID; ++s)
+        for (ListGraph::Node sn : initial)
         {
-            auto n = _tree.addNode();
-            _tree_labels[n] = _graph.id(gh_tree_supernodes[s][0]);
-            final_node_map[s] = n;
+            pool->submit([&split, sn](unsigned worker) { split(sn, worker); });
         }
+        pool->wait();
+        pool.reset();
 
-        for (ListGraph::EdgeIt e(gh_tree); e != INVALID; ++e)
+        // Times of the parallel phases are summed over workers
+        split_stats stats;
+        stats.counts = p_split.tick();
+        for (auto const& w : workers)
         {
-            ListGraph::Node s = final_node_map[gh_tree.u(e)];
-            ListGraph::Node t = final_node_map[gh_tree.v(e)];
-            ListGraph::Edge f = _tree.addEdge(s, t);
-            _tree_flows[f] = gh_tree_flows[e];
+            stats.time_min_cut += w.time_min_cut;
+            stats.time_contraction += w.time_contraction;
+            stats.n_flows += w.n_flows;
         }
+        return stats;
+    }
+
+    void run_gomory_hu_2()
+    {
+        // This is the implementation of the original Gomory-Hu algorithm
+        // It is probably less efficient than Gusfield's algorithm, but it is easier to prove its correctness.
+
+        // The Gomory-Hu Tree begins as a single supernode containing all graph vertices
+        // Each iteration of the algorithm is as follows:
+        // 1. Select a pair of vertices s-t in a supernode S
+        // 2. Find the connected components in T afte removing the supernode, and contract all nodes in each component
+        // 3. Compute the minimum cut between s and t in the contracted graph, creating two new supernodes, S1 and S2
+        // 4. Add S1 and S2 to the Gomory-Hu Tree, with an edge between them with the value of the minimum cut
+        // 5. Connect neighbors of S to S1 and S2, depending on which side of the cut they are in
+        // 6. Repeat until all supernodes contain a single vertex
+
+        // The two supernodes created by a split are independent subproblems:
+        // the components of T minus S (as sets of vertices) are fixed when S
+        // is created, and splitting other supernodes never changes them.
+        // So every split is a task on a work-stealing pool. Steps 1-3 only
+        // read the tree (under a shared lock for step 2), and steps 4-5 are
+        // published under an exclusive lock. Contracted nodes are numbered
+        // canonically, so the tree does not depend on the scheduling.
+
+        timer t_total;
+
+        // Begin with a single supernode containing all nodes
+        csr_graph const& graph = flow_graph();
+        supernode_tree st;
+        st.next.assign(graph.n_nodes(), -1);
+        std::vector<int> members(graph.n_nodes());
+        std::iota(members.begin(), members.end(), 0);
+        st.add(members);
+
+        _telemetry.start(_n_threads, graph.n_nodes());
+        split_stats stats = split_supernodes(graph, st);
+
+        // Finally, populate the class data members. Every supernode now holds
+        // a single node.
+        build_tree(st.edges());
 
-        time_total = t_total.tick();
+        double time_total = t_total.tick();
 
         // Write times to json log
-        global_json_logger.add("gh_time_min_cut", time_min_cut);
-        global_json_logger.add("gh_time_relabel", time_contraction);
+        global_json_logger.add("gh_time_min_cut", stats.time_min_cut);
+        global_json_logger.add("gh_time_relabel", stats.time_contraction);
+        global_json_logger.add_counts("gh_min_cut", stats.counts);
         global_json_logger.add("gh_time_total", time_total);
+        global_json_logger.add("gh_threads", _n_threads);
+        _telemetry.log("gh", [&](int i) { return flow_graph_id(i); });
     }
 
-    int min_k_cut_value(unsigned int k)
+    // The global min cut, the min 2-cut, by Stoer-Wagner and without the
+    // tree: about the cost of one flow instead of n - 1. cut_map is 1 on the
+    // side of the first node and 2 on the other, as min_k_cut_map(2) would
+    // number them. Returns the value of the cut.
+    long long run_min_cut(ListGraph::NodeMap<unsigned int>& cut_map)
     {
-        // Sum the k-1 smallest values in _fl
-
-        timer timer;
-
-        unsigned int n_cuts = k - 1;
-        std::vector<int> heap;    // A heap of size n_cuts
+        timer t_total;
 
-        for (ListGraph::EdgeIt e(_tree); e != INVALID; ++e)
+        stoer_wagner engine;
+        engine.run(_csr);
+        for (std::size_t i = 0; i < _nodes.size(); ++i)
         {
-            heap.push_back(_tree_flows[e]);
-            std::push_heap(heap.begin(), heap.end());
-            if (heap.size() > n_cuts)
-            {
-                std::pop_heap(heap.begin(), heap.end());
-                heap.pop_back();
-            }
+            cut_map[_nodes[i]] = engine.side(int(i)) == engine.side(0) ? 1 : 2;
         }
-        int sum = 0;
-        for (int i = 0; i < n_cuts; ++i)
+
+        global_json_logger.add("min_cut_time_total", t_total.tick());
+        return engine.value();
+    }
+
+    // Add delta to the weight of the edge between graph nodes u and v,
+    // adding the edge if there is none, and update the tree. Only the tree
+    // edges on the u-v tree path are recomputed. The lemon graph given to
+    // the constructor is not changed.
+    void increase_weight(ListGraph::Node u, ListGraph::Node v, int delta)
+    {
+        update_weight(
+            _csr_index[_graph.id(u)], _csr_index[_graph.id(v)], delta);
+    }
+
+    // Subtract delta from the weight of the edge between graph nodes u and
+    // v, removing the edge at 0, and update the tree. Only the tree edges
+    // off the u-v tree path with flows above the min u-v cut minus delta
+    // are recomputed.
+    void decrease_weight(ListGraph::Node u, ListGraph::Node v, int delta)
+    {
+        update_weight(
+            _csr_index[_graph.id(u)], _csr_index[_graph.id(v)], -delta);
+    }
+
+    // Add an edge between graph nodes u and v, merged with the edge
+    // between them if there is one, and update the tree
+    void add_edge(ListGraph::Node u, ListGraph::Node v, int weight)
+    {
+        increase_weight(u, v, weight);
+    }
+
+    // The min cut between graph nodes s and t, read off the Gomory-Hu tree
+    // in constant time. The largest int if s == t.
+    int min_cut_value(ListGraph::Node s, ListGraph::Node t) const
+    {
+        return _cut_index.min_cut(
+            _csr_index[_graph.id(s)], _csr_index[_graph.id(t)]);
+    }
+
+    // The min cut of every pair of graph nodes, in one pass
+    void min_cut_values(
+        std::vector<std::pair<ListGraph::Node, ListGraph::Node>> const& pairs,
+        std::vector<int>& values) const
+    {
+        std::vector<int> s(pairs.size());
+        std::vector<int> t(pairs.size());
+        for (std::size_t i = 0; i < pairs.size(); ++i)
         {
-            sum += heap[i];
+            s[i] = _csr_index[_graph.id(pairs[i].first)];
+            t[i] = _csr_index[_graph.id(pairs[i].second)];
         }
+        values.resize(pairs.size());
+        _cut_index.min_cuts(pairs.size(), s.data(), t.data(), values.data());
+    }
+
+    // The value of the min k-cut: the sum of the k-1 smallest tree flows.
+    // A lookup in the sums built with the tree. For k larger than the
+    // number of nodes, every tree edge is cut.
+    long long min_k_cut_value(unsigned int k)
+    {
+        timer timer;
+
+        long long sum = _smallest_sums[std::min<std::size_t>(
+            k > 0 ? k - 1 : 0, _smallest_sums.size() - 1)];
 
         // Write time to json log
         global_json_logger.add("min_k_cut_value_time", timer.tick());
@@ -464,6 +1286,45 @@ public:
         return sum;
     }
 
+    // The min k-cut values for every k up to max_k: values[k] is the value
+    // for k, and values[0] = values[1] = 0
+    std::vector<long long> min_k_cut_values(unsigned int max_k) const
+    {
+        std::vector<long long> values(std::size_t(max_k) + 1, 0);
+        for (std::size_t k = 2; k <= max_k; ++k)
+        {
+            values[k] =
+                _smallest_sums[std::min(k - 1, _smallest_sums.size() - 1)];
+        }
+        return values;
+    }
+
+    // The merge sequence of the tree edges, heaviest first. Node i of the
+    // dendrogram is graph node _tree_labels of tree node i.
+    cut_dendrogram const& dendrogram() const
+    {
+        return _dendrogram;
+    }
+
+    // The min k-cut maps of several k at once, from the dendrogram:
+    // cut_maps[n][j] is the component of node n for ks[j], numbered as by
+    // min_k_cut_map
+    void min_k_cut_maps(std::vector<unsigned int> const& ks,
+        ListGraph::NodeMap<std::vector<unsigned int>>& cut_maps) const
+    {
+        timer t_total;
+
+        std::vector<unsigned int> labels;
+        _dendrogram.labels(ks, labels);
+        for (std::size_t i = 0; i < _nodes.size(); ++i)
+        {
+            auto first = labels.begin() + i * ks.size();
+            cut_maps[_nodes[i]].assign(first, first + ks.size());
+        }
+
+        global_json_logger.add("min_k_cut_maps_time_total", t_total.tick());
+    }
+
     void min_k_cut_map(
         unsigned int k, ListGraph::NodeMap<unsigned int>& cut_map)
     {
@@ -471,7 +1332,7 @@ public:
         // created by the min-k cut
 
         // Algorithm: Find ids of the k smallest flow values
-        // Make a copy of _tree and delete the k corresponding edges
+        // Build the tree without the k corresponding edges
         // Color the connected components of the resulting graph
 
         timer t_total;
@@ -498,44 +1359,60 @@ public:
 
         timer t_dfs;
 
-        // Make a copy of _tree
-        ListGraph tree_copy;
-        lemon::GraphCopy<ListGraph, ListGraph> copy(_tree, tree_copy);
-        copy.run();
-
-        // Delete the k corresponding edges
+        // Build the tree without the k-1 corresponding edges, in CSR layout.
+        // Tree node ids are contiguous, since _tree is rebuilt from scratch.
+        std::vector<char> is_cut(_tree.maxEdgeId() + 1, 0);
         for (auto& e : heap)
         {
-            tree_copy.erase(e);
+            is_cut[_tree.id(e)] = 1;
         }
+        std::vector<csr_graph::edge> forest_edges;
+        for (ListGraph::EdgeIt e(_tree); e != INVALID; ++e)
+        {
+            if (!is_cut[_tree.id(e)])
+            {
+                forest_edges.push_back(
+                    {_tree.id(_tree.u(e)), _tree.id(_tree.v(e)), 0});
+            }
+        }
+        csr_graph forest;
+        forest.build(_tree.maxNodeId() + 1, forest_edges);
 
         // Color the connected components of the resulting graph
         unsigned int color = 0;
-        // Do a DFS on the tree_copy
-        for (ListGraph::NodeIt n(tree_copy); n != INVALID; ++n)
+        std::vector<unsigned int> colors(forest.n_nodes(), 0);
+        std::vector<int> stack;
+        // Do a DFS on the forest
+        for (int n = 0; n < forest.n_nodes(); ++n)
         {
-            if (cut_map[n] == 0)
+            if (colors[n] == 0)
             {
                 color++;
-                std::stack<ListGraph::Node> stack;
-                stack.push(n);
+                colors[n] = color;
+                stack.push_back(n);
                 while (!stack.empty())
                 {
-                    ListGraph::Node m = stack.top();
-                    stack.pop();
-                    cut_map[m] = color;
-                    for (ListGraph::OutArcIt e(tree_copy, m); e != INVALID; ++e)
+                    int m = stack.back();
+                    stack.pop_back();
+                    for (int a = forest.begin(m); a < forest.end(m); ++a)
                     {
-                        ListGraph::Node v = tree_copy.target(e);
-                        if (cut_map[v] == 0)
+                        int v = forest.target(a);
+                        if (colors[v] == 0)
                         {
-                            stack.push(v);
+                            colors[v] = color;
+                            stack.push_back(v);
                         }
                     }
                 }
             }
         }
 
+        // Tree nodes are labelled with the id of their graph node
+        for (ListGraph::NodeIt n(_tree); n != INVALID; ++n)
+        {
+            cut_map[_graph.nodeFromId(_tree_labels[n])] = colors[_tree.id(n)];
+        }
+
         global_json_logger.add("min_k_cut_map_time_dfs", t_dfs.tick());
         global_json_logger.add("min_k_cut_map_time_total", t_total.tick());
     }
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "csr_graph.hpp"
+#include "edge_list.hpp"
+#include "thread_pool.hpp"
+
+// A randomized min k-cut solver, by the recursive contraction of Karger and
+// Stein. A trial contracts random edges, picked with probability
+// proportional to their weight, down to n / sqrt(2) nodes, twice, and
+// recurses on both results; small graphs are contracted straight down to k
+// nodes. The best k-cut of many independent trials is kept. Each trial
+// finds a min k-cut with some probability, so more trials give better cuts.
+//
+// Contracting in random weighted order is Kruskal's algorithm on edge keys
+// drawn from exponential distributions of rate the weight, so one
+// contraction is a sort and a union-find pass.
+//
+// Trials run in parallel on a thread pool. Trial i draws from a generator
+// seeded with the seed and i, so the result does not depend on the number
+// of threads.
+class karger_stein
+{
+    unsigned _n_threads = 1;
+    unsigned _n_trials = 64;
+    std::uint64_t _seed = 1;
+
+    long long _value = 0;
+    std::vector<unsigned int> _labels;
+
+    // Graphs of at most this many nodes, or k + this, are contracted
+    // straight down to k nodes
+    static constexpr int base_size = 6;
+
+    static int find(std::vector<int>& root, int u)
+    {
+        while (root[u] != u)
+        {
+            root[u] = root[root[u]];
+            u = root[u];
+        }
+        return u;
+    }
+
+    // Contract random edges of a simple graph of n nodes until target nodes
+    // are left. map[u] is the node of u in the contracted graph, whose
+    // simple edges are written to contracted.
+    template <typename Generator>
+    static void contract(int n, std::vector<csr_graph::edge> const& edges,
+        int target, Generator& gen, std::vector<int>& map,
+        std::vector<csr_graph::edge>& contracted)
+    {
+        std::vector<double> key(edges.size());
+        std::exponential_distribution<double> exponential;
+        for (std::size_t i = 0; i < edges.size(); ++i)
+        {
+            key[i] = edges[i].weight > 0
+                ? exponential(gen) / edges[i].weight
+                : std::numeric_limits<double>::infinity();
+        }
+        std::vector<int> order(edges.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return key[a] < key[b]; });
+
+        std::vector<int> root(n);
+        std::iota(root.begin(), root.end(), 0);
+        int n_left = n;
+        for (std::size_t i = 0; i < order.size() && n_left > target; ++i)
+        {
+            int a = find(root, edges[order[i]].u);
+            int b = find(root, edges[order[i]].v);
+            if (a != b)
+            {
+                root[a] = b;
+                --n_left;
+            }
+        }
+        // More components than target: merging them cuts nothing
+        for (int u = 1; u < n && n_left > target; ++u)
+        {
+            int a = find(root, 0);
+            int b = find(root, u);
+            if (a != b)
+            {
+                root[b] = a;
+                --n_left;
+            }
+        }
+
+        map.assign(n, -1);
+        std::vector<int> index(n, -1);
+        int n_nodes = 0;
+        for (int u = 0; u < n; ++u)
+        {
+            int r = find(root, u);
+            if (index[r] == -1)
+                index[r] = n_nodes++;
+            map[u] = index[r];
+        }
+        contracted.clear();
+        for (csr_graph::edge const& e : edges)
+        {
+            contracted.push_back({map[e.u], map[e.v], e.weight});
+        }
+        simplify_edges(n_nodes, contracted);
+    }
+
+    // The best k-cut found by the recursive contraction of a simple graph
+    // of n > k nodes: its value, and the part of each node in comp
+    template <typename Generator>
+    static long long trial(int n, std::vector<csr_graph::edge> const& edges,
+        unsigned int k, Generator& gen, std::vector<int>& comp)
+    {
+        std::vector<int> map;
+        std::vector<csr_graph::edge> contracted;
+        if (n <= std::max<int>(base_size, 2 * k))
+        {
+            contract(n, edges, int(k), gen, comp, contracted);
+            long long value = 0;
+            for (csr_graph::edge const& e : contracted)
+            {
+                value += e.weight;
+            }
+            return value;
+        }
+
+        int target = std::max<int>(
+            int(k) + 1, int(std::ceil(1 + n / std::sqrt(2.0))));
+        long long best = std::numeric_limits<long long>::max();
+        std::vector<int> sub_comp;
+        for (int branch = 0; branch < 2; ++branch)
+        {
+            contract(n, edges, target, gen, map, contracted);
+            long long value = trial(target, contracted, k, gen, sub_comp);
+            if (value < best)
+            {
+                best = value;
+                comp.resize(n);
+                for (int u = 0; u < n; ++u)
+                {
+                    comp[u] = sub_comp[map[u]];
+                }
+            }
+        }
+        return best;
+    }
+
+public:
+    karger_stein() = default;
+
+    void set_threads(unsigned n_threads)
+    {
+        _n_threads = std::max(1u, n_threads);
+    }
+
+    // Number of independent trials of a run
+    void set_trials(unsigned n_trials)
+    {
+        _n_trials = std::max(1u, n_trials);
+    }
+
+    void set_seed(std::uint64_t seed)
+    {
+        _seed = seed;
+    }
+
+    // Search a min k-cut of the simple graph with the given edges on nodes
+    // 0..n_nodes-1. For k >= n_nodes every node is a part of its own.
+    // Returns the value of the best cut found.
+    long long run(
+        int n_nodes, std::vector<csr_graph::edge> const& edges, unsigned int k)
+    {
+        std::vector<int> comp(n_nodes);
+        if (n_nodes <= int(k))
+        {
+            std::iota(comp.begin(), comp.end(), 0);
+            _value = 0;
+            for (csr_graph::edge const& e : edges)
+            {
+                _value += e.weight;
+            }
+        }
+        else
+        {
+            // The best trial of each worker; ties go to the first trial
+            struct result
+            {
+                long long value = std::numeric_limits<long long>::max();
+                std::size_t trial = 0;
+                std::vector<int> comp;
+            };
+            std::vector<result> best(_n_threads);
+            auto run_trial = [&](std::size_t i, unsigned worker) {
+                std::seed_seq seq{std::uint32_t(_seed),
+                    std::uint32_t(_seed >> 32), std::uint32_t(i),
+                    std::uint32_t(std::uint64_t(i) >> 32)};
+                std::mt19937_64 gen(seq);
+                std::vector<int> trial_comp;
+                long long value = trial(n_nodes, edges, k, gen, trial_comp);
+                result& r = best[worker];
+                if (value < r.value || (value == r.value && i < r.trial))
+                {
+                    r.value = value;
+                    r.trial = i;
+                    r.comp = std::move(trial_comp);
+                }
+            };
+            if (_n_threads > 1)
+            {
+                thread_pool pool(_n_threads);
+                pool.parallel_for(_n_trials, run_trial);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < _n_trials; ++i)
+                {
+                    run_trial(i, 0);
+                }
+            }
+
+            result const* first = &best[0];
+            for (result const& r : best)
+            {
+                if (r.value < first->value ||
+                    (r.value == first->value && r.trial < first->trial))
+                    first = &r;
+            }
+            _value = first->value;
+            comp = first->comp;
+        }
+
+        // Number the parts from 1, by their smallest node, as
+        // k_min_cut::min_k_cut_map does
+        std::vector<unsigned int> label(n_nodes, 0);
+        unsigned int n_labels = 0;
+        _labels.resize(n_nodes);
+        for (int u = 0; u < n_nodes; ++u)
+        {
+            if (label[comp[u]] == 0)
+                label[comp[u]] = ++n_labels;
+            _labels[u] = label[comp[u]];
+        }
+        return _value;
+    }
+
+    // The value of the best k-cut of the last run
+    long long value() const
+    {
+        return _value;
+    }
+
+    // The part of each node in the best k-cut of the last run, from 1
+    std::vector<unsigned int> const& labels() const
+    {
+        return _labels;
+    }
+
+    // Write the parts to a lemon node map, in the format of
+    // k_min_cut::min_k_cut_map. Node i of the graph run on is nodes[i].
+    template <typename Node, typename NodeMap>
+    void cut_map(std::vector<Node> const& nodes, NodeMap& cut_map) const
+    {
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            cut_map[nodes[i]] = _labels[i];
+        }
+    }
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <lemon/preflow.h>
+#include <memory>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Minimum s-t cut by lemon's Preflow (highest-label push-relabel), run on a
+// csr_digraph view of a csr_graph. The view is rebuilt only when the graph
+// changes.
+//
+// Same interface as push_relabel.
+class lemon_preflow
+{
+public:
+    using flow_type = std::int64_t;
+
+private:
+    using Digraph = lemon::StaticDigraph;
+
+    std::unique_ptr<csr_digraph> _view;
+    std::uint64_t _graph_stamp = 0;
+
+    std::vector<std::uint64_t> _source_side;
+    flow_type _flow = 0;
+
+public:
+    lemon_preflow() = default;
+
+    // Compute a maximum s-t flow value and a minimum s-t cut of g
+    void run(csr_graph const& g, int s, int t)
+    {
+        if (!_view || _graph_stamp != g.stamp())
+        {
+            _view = std::make_unique<csr_digraph>(g);
+            _graph_stamp = g.stamp();
+        }
+
+        lemon::Preflow<Digraph, Digraph::ArcMap<int>> preflow(
+            _view->digraph(), _view->capacity(), csr_digraph::node(s),
+            csr_digraph::node(t));
+        preflow.runMinCut();
+
+        _flow = preflow.flowValue();
+        int n = g.n_nodes();
+        _source_side.assign((n + 63) / 64, 0);
+        for (int u = 0; u < n; ++u)
+        {
+            if (preflow.minCut(csr_digraph::node(u)))
+                _source_side[u / 64] |= std::uint64_t(1) << (u % 64);
+        }
+    }
+
+    flow_type flow_value() const
+    {
+        return _flow;
+    }
+
+    // True if u is on the source side of the minimum cut
+    bool min_cut(int u) const
+    {
+        return (_source_side[u / 64] >> (u % 64)) & 1;
+    }
+
+    // The source side of the minimum cut as a bitset: bit u % 64 of word u / 64
+    std::vector<std::uint64_t> const& source_side() const
+    {
+        return _source_side;
+    }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file mapped read-only into memory, unmapped by the destructor.
+// The pages are hinted for sequential reading, so parsing the text streams
+// straight from the page cache without a copy. Where mmap is not available
+// the file is read into a buffer instead.
+class mapped_file
+{
+    char const* _data = nullptr;
+    std::size_t _size = 0;
+    bool _open = false;
+#if defined(_WIN32)
+    std::vector<char> _buffer;
+#endif
+
+public:
+    mapped_file() = default;
+
+    explicit mapped_file(std::string const& path)
+    {
+        open(path);
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    ~mapped_file()
+    {
+        close();
+    }
+
+    // Map the file at path, replacing any file mapped before.
+    // Returns false if it cannot be opened.
+    bool open(std::string const& path)
+    {
+        close();
+#if defined(_WIN32)
+        std::ifstream is(path, std::ios::binary);
+        if (!is)
+            return false;
+        _buffer.assign(std::istreambuf_iterator<char>(is),
+            std::istreambuf_iterator<char>());
+        _data = _buffer.data();
+        _size = _buffer.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        _size = static_cast<std::size_t>(st.st_size);
+        if (_size > 0)
+        {
+            void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                _size = 0;
+                return false;
+            }
+            ::madvise(p, _size, MADV_SEQUENTIAL);
+            _data = static_cast<char const*>(p);
+        }
+        // The mapping outlives the descriptor
+        ::close(fd);
+#endif
+        _open = true;
+        return true;
+    }
+
+    void close()
+    {
+#if defined(_WIN32)
+        _buffer.clear();
+#else
+        if (_data)
+            ::munmap(const_cast<char*>(_data), _size);
+#endif
+        _data = nullptr;
+        _size = 0;
+        _open = false;
+    }
+
+    bool is_open() const
+    {
+        return _open;
+    }
+
+    char const* data() const
+    {
+        return _data;
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+    char const* begin() const
+    {
+        return _data;
+    }
+
+    char const* end() const
+    {
+        return _data + _size;
+    }
+};
@@ -1,78 +1,116 @@
 #pragma once
 
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
-
-template <typename Graph, typename ArcMap>
-std::istream& readMtxGraph(
-    Graph& graph, ArcMap& arc_map, std::istream& is = std::cin)
+#include "mapped_file.hpp"
+#include "reader_util.hpp"
+
+// Parse the MatrixMarket text [first, last) into its number of nodes and its
+// edges, with 0-based nodes. Entries without a weight get weight 1.
+// Returns false on invalid data. The entries are parsed on n_threads threads
+// (see parse_entries).
+inline bool parseMtx(char const* first, char const* last, int& n_nodes,
+    std::vector<csr_graph::edge>& edges, unsigned n_threads = 1)
 {
-    graph.clear();
-
-    std::string line;
+    text_scanner in(first, last);
 
     // First line start with "%%MatrixMarket matrix coordinate*"
-    if (!getline(is, line) ||
-        line.substr(0, 32) != "%%MatrixMarket matrix coordinate")
+    if (!in.starts_with("%%MatrixMarket matrix coordinate"))
     {
         std::cerr << "Invalid MatrixMarket header" << std::endl;
-        return is;
+        return false;
     }
+    in.skip_line();
 
     // Skip comments
-    while (getline(is, line))
-    {
-        if (line[0] != '%')
-        {
-            break;
-        }
-    }
+    in.skip_lines('%');
 
     // Read header
     int n, m;
-    if (!(std::istringstream(line) >> n >> n >> m))
+    if (!in.read(n) || !in.read(n) || !in.read(m) || n < 0 || m < 0)
     {
         std::cerr << "Invalid MatrixMarket header" << std::endl;
-        return is;
+        return false;
     }
+    in.skip_line();
 
-    // Add nodes
-    for (int i = 0; i < n; ++i)
+    // Read edges
+    auto parse_entry = [n](text_scanner& line, csr_graph::edge& e) {
+        int u, v;
+        if (!line.read(u) || !line.read(v) || u < 1 || u > n || v < 1 ||
+            v > n)
+            return false;
+
+        // Try parsing weight. If it fails, set it to 1
+        int w;
+        if (line.at_line_end() || !line.read(w))
+        {
+            w = 1;
+        }
+
+        e = {u - 1, v - 1, w};
+        return true;
+    };
+    if (!parse_entries(
+            in.position(), last, m, '%', parse_entry, edges, n_threads))
     {
-        graph.addNode();
+        std::cerr << "Invalid MatrixMarket data" << std::endl;
+        return false;
     }
 
-    // Add edges
-    for (int i = 0; i < m; ++i)
+    n_nodes = n;
+    return true;
+}
+
+// Read the number of nodes and the edges of a MatrixMarket file, which is
+// memory-mapped and parsed in place on n_threads threads. Returns false if
+// the file cannot be read or is invalid.
+inline bool readMtxEdges(std::string const& path, int& n_nodes,
+    std::vector<csr_graph::edge>& edges, unsigned n_threads = 1)
+{
+    mapped_file file;
+    if (!file.open(path))
     {
-        if (!getline(is, line))
-        {
-            std::cerr << "Invalid MatrixMarket data" << std::endl;
-            return is;
-        }
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    return parseMtx(file.begin(), file.end(), n_nodes, edges, n_threads);
+}
 
-        std::istringstream line_is(line);
+// Read a MatrixMarket graph from a file (see readMtxEdges)
+template <typename Graph, typename ArcMap>
+bool readMtxFile(Graph& graph, ArcMap& arc_map, std::string const& path,
+    unsigned n_threads = 1)
+{
+    graph.clear();
 
-        int u, v, w;
+    int n;
+    std::vector<csr_graph::edge> edges;
+    if (!readMtxEdges(path, n, edges, n_threads))
+        return false;
 
-        if (!(line_is >> u >> v))
-        {
-            std::cerr << "Invalid MatrixMarket data" << std::endl;
-            return is;
-        }
+    fill_graph(graph, arc_map, n, edges);
+    return true;
+}
 
-        auto e = graph.addEdge(graph.nodeFromId(u - 1), graph.nodeFromId(v - 1));
+template <typename Graph, typename ArcMap>
+std::istream& readMtxGraph(
+    Graph& graph, ArcMap& arc_map, std::istream& is = std::cin)
+{
+    graph.clear();
 
-        // Try parsing weight. If it fails, set it to 1
-        if (!(line_is >> w))
-        {
-            w = 1;
-        }
+    // Read the rest of the stream at once, and parse it in place
+    std::string text(
+        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>{});
 
-        arc_map[e] = w;
+    int n;
+    std::vector<csr_graph::edge> edges;
+    if (parseMtx(text.data(), text.data() + text.size(), n, edges))
+    {
+        fill_graph(graph, arc_map, n, edges);
     }
 
     return is;
 }
-
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Minimum s-t cut by Hochbaum's pseudoflow algorithm (lowest label variant)
+// on a csr_graph.
+//
+// s and t are taken out of the graph: the arcs out of s and into t are
+// saturated, which leaves every other node with an excess or a deficit.
+// The nodes form a forest of branches, each with its excess at its root.
+// A branch with a positive excess is strong. The lowest labelled strong
+// branch looks for a residual arc to a weak node; if it finds one it is
+// merged into that node's branch and its excess is pushed towards the weak
+// root, splitting the path where arcs saturate. Otherwise its nodes are
+// relabeled. When no strong branch can progress, the strong nodes and s form
+// the source side of a minimum cut.
+//
+// Relabeling one step at a time, a strong branch that cannot reach any weak
+// node would climb all the way to label n. So after every n relabels, a
+// global update (a BFS from the weak nodes in the residual graph) lifts such
+// branches to n at once.
+//
+// Only this first phase runs, so the flow value is computed as the capacity
+// of the cut. Same interface as push_relabel; the workspace is kept between
+// runs.
+class pseudoflow
+{
+public:
+    using flow_type = std::int64_t;
+
+private:
+    // Residual capacity of each arc
+    std::vector<int> _res;
+    std::vector<flow_type> _excess;
+    std::vector<int> _label;
+    std::size_t _n_relabels = 0;
+    // Next arc to try when looking for a weak node
+    std::vector<int> _current;
+
+    // The branches, with parent/child/sibling links. _parent_arc[u] is the
+    // arc from u to its parent.
+    std::vector<int> _parent;
+    std::vector<int> _parent_arc;
+    std::vector<int> _first_child;
+    std::vector<int> _next_sibling;
+    std::vector<int> _prev_sibling;
+    // Next child to visit when searching a strong branch
+    std::vector<int> _next_scan;
+
+    // Scratch for the global update
+    std::vector<int> _root;
+    std::vector<char> _live;
+    std::vector<char> _live_branch;
+    std::vector<int> _queue;
+    std::vector<int> _stack;
+
+    // Strong roots, by label, as singly linked lists
+    std::vector<int> _bucket_head;
+    std::vector<int> _bucket_next;
+    int _lowest = 0;
+
+    std::vector<std::uint64_t> _source_side;
+    flow_type _flow = 0;
+    std::size_t _n_merges = 0;
+
+    csr_graph const* _g = nullptr;
+    int _n = 0;
+    int _s = 0;
+    int _t = 0;
+
+    void add_strong_root(int u)
+    {
+        int l = _label[u];
+        if (l >= _n)
+            return;
+        _bucket_next[u] = _bucket_head[l];
+        _bucket_head[l] = u;
+        _lowest = std::min(_lowest, l);
+    }
+
+    // Set _root[u] to the root of the branch of every node u
+    void find_roots()
+    {
+        std::fill(_root.begin(), _root.end(), -1);
+        for (int u = 0; u < _n; ++u)
+        {
+            int r = u;
+            while (_root[r] == -1 && _parent[r] != -1)
+            {
+                r = _parent[r];
+            }
+            r = _root[r] == -1 ? r : _root[r];
+            for (int v = u; _root[v] == -1;
+                 v = _parent[v] == -1 ? v : _parent[v])
+            {
+                _root[v] = r;
+            }
+        }
+    }
+
+    // Mark u and, if its branch is not live yet, the whole branch as live
+    void make_live(int u)
+    {
+        if (!_live[u])
+        {
+            _live[u] = 1;
+            _queue.push_back(u);
+        }
+        int r = _root[u];
+        if (_live_branch[r])
+            return;
+        _live_branch[r] = 1;
+        _stack.push_back(r);
+        while (!_stack.empty())
+        {
+            int v = _stack.back();
+            _stack.pop_back();
+            if (!_live[v])
+            {
+                _live[v] = 1;
+                _queue.push_back(v);
+            }
+            for (int c = _first_child[v]; c != -1; c = _next_sibling[c])
+            {
+                _stack.push_back(c);
+            }
+        }
+    }
+
+    // Lift to n every strong branch that can never progress: a branch is
+    // live if it is weak, or if one of its nodes has a residual path to a
+    // node of a live branch. Nothing is ever pushed into the other
+    // branches, so they stay unable to reach a weak node.
+    void global_update()
+    {
+        find_roots();
+
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+
+        // Reverse BFS from the weak branches
+        _queue.clear();
+        std::fill(_live.begin(), _live.end(), 0);
+        std::fill(_live_branch.begin(), _live_branch.end(), 0);
+        for (int u = 0; u < _n; ++u)
+        {
+            if (u != _s && u != _t && _excess[_root[u]] <= 0)
+                make_live(u);
+        }
+        for (std::size_t head = 0; head < _queue.size(); ++head)
+        {
+            int v = _queue[head];
+            for (int a = _g->begin(v); a < _g->end(v); ++a)
+            {
+                int u = targets[a];
+                if (!_live[u] && u != _s && u != _t && _res[reverses[a]] > 0)
+                    make_live(u);
+            }
+        }
+
+        for (int u = 0; u < _n; ++u)
+        {
+            if (!_live_branch[_root[u]])
+                _label[u] = _n;
+        }
+    }
+
+    void attach(int child, int parent, int arc)
+    {
+        _parent[child] = parent;
+        _parent_arc[child] = arc;
+        _prev_sibling[child] = -1;
+        _next_sibling[child] = _first_child[parent];
+        if (_first_child[parent] != -1)
+            _prev_sibling[_first_child[parent]] = child;
+        _first_child[parent] = child;
+    }
+
+    void detach(int child)
+    {
+        int parent = _parent[child];
+        if (_prev_sibling[child] != -1)
+            _next_sibling[_prev_sibling[child]] = _next_sibling[child];
+        else
+            _first_child[parent] = _next_sibling[child];
+        if (_next_sibling[child] != -1)
+            _prev_sibling[_next_sibling[child]] = _prev_sibling[child];
+        _parent[child] = -1;
+    }
+
+    // A residual arc from strong to a node labelled one less, or -1. Strong
+    // nodes are all labelled at least as high as strong, so that node is weak.
+    int find_weak_arc(int strong)
+    {
+        int const* targets = _g->targets();
+        int end = _g->end(strong);
+        for (int& a = _current[strong]; a < end; ++a)
+        {
+            if (_res[a] > 0 && _label[targets[a]] == _label[strong] - 1)
+                return a;
+        }
+        return -1;
+    }
+
+    // Advance the scan of u to its next child with the same label. If there
+    // is none, relabel u.
+    void check_children(int u)
+    {
+        int c = _next_scan[u];
+        while (c != -1 && _label[c] != _label[u])
+        {
+            c = _next_sibling[c];
+        }
+        _next_scan[u] = c;
+        if (c == -1)
+        {
+            ++_label[u];
+            ++_n_relabels;
+            _current[u] = _g->begin(u);
+        }
+    }
+
+    // Hang the branch of strong (rooted at root) from weak through the arc
+    // strong->weak, and push the excess of root towards the weak root
+    void merge(int root, int strong, int weak, int arc)
+    {
+        ++_n_merges;
+        int const* reverses = _g->reverses();
+
+        // Reverse the path from strong to root
+        int u = strong;
+        int new_parent = weak;
+        int new_arc = arc;
+        while (_parent[u] != -1)
+        {
+            int old_parent = _parent[u];
+            int old_arc = _parent_arc[u];
+            detach(u);
+            attach(u, new_parent, new_arc);
+            new_parent = u;
+            new_arc = reverses[old_arc];
+            u = old_parent;
+        }
+        attach(u, new_parent, new_arc);
+
+        // Push the excess of root up to the new root, splitting the branch
+        // below every arc that saturates
+        u = root;
+        while (_excess[u] > 0 && _parent[u] != -1)
+        {
+            int p = _parent[u];
+            int a = _parent_arc[u];
+            int delta = static_cast<int>(std::min<flow_type>(_excess[u], _res[a]));
+            _res[a] -= delta;
+            _res[reverses[a]] += delta;
+            _excess[u] -= delta;
+            _excess[p] += delta;
+            if (_excess[u] > 0)
+            {
+                detach(u);
+                add_strong_root(u);
+            }
+            u = p;
+        }
+        // If the excess made it to the weak root, the root may have become
+        // strong
+        if (_parent[u] == -1 && _excess[u] > 0)
+            add_strong_root(u);
+    }
+
+    void process_root(int root)
+    {
+        int u = root;
+        _next_scan[u] = _first_child[u];
+        int a = find_weak_arc(u);
+        if (a != -1)
+        {
+            merge(root, u, _g->target(a), a);
+            return;
+        }
+        check_children(u);
+
+        // Depth first search of the nodes of the branch with the label of
+        // the root, relabeling each once its subtree is done
+        while (u != -1)
+        {
+            while (_next_scan[u] != -1)
+            {
+                int c = _next_scan[u];
+                _next_scan[u] = _next_sibling[c];
+                u = c;
+                _next_scan[u] = _first_child[u];
+                a = find_weak_arc(u);
+                if (a != -1)
+                {
+                    merge(root, u, _g->target(a), a);
+                    return;
+                }
+                check_children(u);
+            }
+            if (u == root)
+                break;
+            u = _parent[u];
+            check_children(u);
+        }
+
+        add_strong_root(root);
+    }
+
+public:
+    pseudoflow() = default;
+
+    // Compute a maximum s-t flow value and a minimum s-t cut of g
+    void run(csr_graph const& g, int s, int t)
+    {
+        _g = &g;
+        _n = g.n_nodes();
+        _s = s;
+        _t = t;
+        int n = _n;
+
+        _res.assign(g.capacities(), g.capacities() + g.n_arcs());
+        _excess.assign(n, 0);
+        _label.assign(n, 1);
+        _current.resize(n);
+        _parent.assign(n, -1);
+        _parent_arc.assign(n, -1);
+        _first_child.assign(n, -1);
+        _next_sibling.assign(n, -1);
+        _prev_sibling.assign(n, -1);
+        _next_scan.assign(n, -1);
+        _root.resize(n);
+        _live.resize(n);
+        _live_branch.resize(n);
+        _bucket_head.assign(n + 1, -1);
+        _bucket_next.assign(n, -1);
+        _lowest = n;
+
+        int const* targets = g.targets();
+        int const* reverses = g.reverses();
+
+        // Take s and t out: saturate the arcs out of s and into t, and make
+        // the arcs into s and out of t unusable
+        for (int a = g.begin(s); a < g.end(s); ++a)
+        {
+            _excess[targets[a]] += _res[a];
+            _res[a] = 0;
+            _res[reverses[a]] = 0;
+        }
+        for (int a = g.begin(t); a < g.end(t); ++a)
+        {
+            _excess[targets[a]] -= _res[reverses[a]];
+            _res[a] = 0;
+            _res[reverses[a]] = 0;
+        }
+        // A direct s-t edge is already counted in the cut below
+        _label[s] = n;
+        _label[t] = 0;
+        _excess[s] = 0;
+        _excess[t] = 0;
+
+        global_update();
+        for (int u = 0; u < n; ++u)
+        {
+            _current[u] = g.begin(u);
+            if (_excess[u] > 0 && u != s && u != t)
+                add_strong_root(u);
+        }
+
+        std::size_t relabels_at_update = _n_relabels;
+        while (true)
+        {
+            while (_lowest < n && _bucket_head[_lowest] == -1)
+            {
+                ++_lowest;
+            }
+            if (_lowest >= n)
+                break;
+            int root = _bucket_head[_lowest];
+            _bucket_head[_lowest] = _bucket_next[root];
+            // The root may have been lifted since it was queued
+            if (_label[root] != _lowest)
+                continue;
+            process_root(root);
+
+            if (_n_relabels - relabels_at_update > std::size_t(n))
+            {
+                global_update();
+                relabels_at_update = _n_relabels;
+            }
+        }
+
+        // The source side is s and the strong nodes: the nodes whose root
+        // has a positive excess
+        find_roots();
+        _source_side.assign((n + 63) / 64, 0);
+        for (int u = 0; u < n; ++u)
+        {
+            if (u == s || (u != t && _excess[_root[u]] > 0))
+                _source_side[u / 64] |= std::uint64_t(1) << (u % 64);
+        }
+
+        // The flow value is the capacity of the cut
+        _flow = 0;
+        for (int u = 0; u < n; ++u)
+        {
+            if (!min_cut(u))
+                continue;
+            for (int a = g.begin(u); a < g.end(u); ++a)
+            {
+                if (!min_cut(targets[a]))
+                    _flow += g.capacity(a);
+            }
+        }
+    }
+
+    flow_type flow_value() const
+    {
+        return _flow;
+    }
+
+    // True if u is on the source side of the minimum cut
+    bool min_cut(int u) const
+    {
+        return (_source_side[u / 64] >> (u % 64)) & 1;
+    }
+
+    // The source side of the minimum cut as a bitset: bit u % 64 of word u / 64
+    std::vector<std::uint64_t> const& source_side() const
+    {
+        return _source_side;
+    }
+
+    std::size_t n_merges() const
+    {
+        return _n_merges;
+    }
+};
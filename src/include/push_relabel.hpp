@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "csr_graph.hpp"
+
+// Minimum s-t cut by highest-label push-relabel on a csr_graph.
+//
+// Only the first phase of the algorithm runs: it computes a maximum preflow,
+// which is enough for the flow value and a minimum cut. It uses the gap
+// heuristic, and global relabeling (an exact BFS from t in the residual graph)
+// at the start and after every n relabels.
+//
+// The workspace is kept between runs. Between two runs on the same graph
+// only the nodes that held excess (and their arcs) are reset, which is much
+// less than the whole graph when cuts are unbalanced.
+class push_relabel
+{
+public:
+    using flow_type = std::int64_t;
+
+private:
+    // Residual capacity of each arc
+    std::vector<int> _res;
+    std::vector<flow_type> _excess;
+    std::vector<int> _label;
+    // Next arc to try in a discharge
+    std::vector<int> _current;
+
+    // Active nodes (label < n, positive excess) by label, as singly linked lists
+    std::vector<int> _active_head;
+    std::vector<int> _active_next;
+    int _max_active = -1;
+
+    // All nodes with label < n, by label, as doubly linked lists (for gaps)
+    std::vector<int> _layer_head;
+    std::vector<int> _layer_next;
+    std::vector<int> _layer_prev;
+    int _max_label = 0;
+
+    std::vector<int> _queue;
+
+    // Nodes whose excess or outgoing residual capacities have changed
+    std::vector<int> _dirty;
+    std::vector<char> _is_dirty;
+    // Build stamp of the graph the residual capacities belong to
+    std::uint64_t _graph_stamp = 0;
+
+    // Bit u is set if node u is on the source side of the cut
+    std::vector<std::uint64_t> _source_side;
+
+    flow_type _flow = 0;
+
+    std::size_t _n_pushes = 0;
+    std::size_t _n_relabels = 0;
+    std::size_t _n_global_relabels = 0;
+
+    csr_graph const* _g = nullptr;
+    int _n = 0;
+    int _s = 0;
+    int _t = 0;
+
+    void mark_dirty(int u)
+    {
+        if (!_is_dirty[u])
+        {
+            _is_dirty[u] = 1;
+            _dirty.push_back(u);
+        }
+    }
+
+    void add_active(int u)
+    {
+        int d = _label[u];
+        _active_next[u] = _active_head[d];
+        _active_head[d] = u;
+        _max_active = std::max(_max_active, d);
+    }
+
+    void add_to_layer(int u)
+    {
+        int d = _label[u];
+        _layer_prev[u] = -1;
+        _layer_next[u] = _layer_head[d];
+        if (_layer_head[d] != -1)
+            _layer_prev[_layer_head[d]] = u;
+        _layer_head[d] = u;
+        _max_label = std::max(_max_label, d);
+    }
+
+    void remove_from_layer(int u)
+    {
+        int d = _label[u];
+        if (_layer_prev[u] != -1)
+            _layer_next[_layer_prev[u]] = _layer_next[u];
+        else
+            _layer_head[d] = _layer_next[u];
+        if (_layer_next[u] != -1)
+            _layer_prev[_layer_next[u]] = _layer_prev[u];
+    }
+
+    // Set every label to the exact distance to t in the residual graph, or
+    // to n if t cannot be reached, and rebuild the buckets
+    void global_relabel()
+    {
+        ++_n_global_relabels;
+
+        std::fill(_label.begin(), _label.begin() + _n, _n);
+        std::fill(_active_head.begin(), _active_head.begin() + _n + 1, -1);
+        std::fill(_layer_head.begin(), _layer_head.begin() + _n + 1, -1);
+        _max_active = -1;
+        _max_label = 0;
+
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+
+        _label[_t] = 0;
+        add_to_layer(_t);
+        _queue.clear();
+        _queue.push_back(_t);
+        for (std::size_t head = 0; head < _queue.size(); ++head)
+        {
+            int v = _queue[head];
+            int d = _label[v] + 1;
+            for (int a = _g->begin(v); a < _g->end(v); ++a)
+            {
+                int u = targets[a];
+                // The arc u->v must have residual capacity
+                if (_label[u] == _n && u != _s && _res[reverses[a]] > 0)
+                {
+                    _label[u] = d;
+                    _current[u] = _g->begin(u);
+                    add_to_layer(u);
+                    if (_excess[u] > 0)
+                        add_active(u);
+                    _queue.push_back(u);
+                }
+            }
+        }
+    }
+
+    // Push excess out of u until it is empty or u is relabeled to n
+    void discharge(int u)
+    {
+        int const* targets = _g->targets();
+        int const* reverses = _g->reverses();
+
+        while (true)
+        {
+            int d = _label[u];
+            int end = _g->end(u);
+            for (int& a = _current[u]; a < end; ++a)
+            {
+                int v = targets[a];
+                if (_res[a] > 0 && _label[v] == d - 1)
+                {
+                    int delta = static_cast<int>(
+                        std::min<flow_type>(_excess[u], _res[a]));
+                    _res[a] -= delta;
+                    _res[reverses[a]] += delta;
+                    _excess[u] -= delta;
+                    if (_excess[v] == 0)
+                    {
+                        mark_dirty(v);
+                        if (v != _t)
+                            add_active(v);
+                    }
+                    _excess[v] += delta;
+                    ++_n_pushes;
+
+                    if (_excess[u] == 0)
+                        return;
+                }
+            }
+
+            // Relabel. If u was alone in its layer, no node above it can
+            // reach t anymore (gap): lift all of them to n.
+            ++_n_relabels;
+            remove_from_layer(u);
+            if (_layer_head[d] == -1)
+            {
+                for (int l = d + 1; l <= _max_label; ++l)
+                {
+                    for (int v = _layer_head[l]; v != -1; v = _layer_next[v])
+                    {
+                        _label[v] = _n;
+                    }
+                    _layer_head[l] = -1;
+                    _active_head[l] = -1;
+                }
+                _max_label = d - 1;
+                _max_active = std::min(_max_active, d - 1);
+                _label[u] = _n;
+                return;
+            }
+
+            int new_label = _n;
+            for (int a = _g->begin(u); a < end; ++a)
+            {
+                if (_res[a] > 0)
+                    new_label = std::min(new_label, _label[targets[a]] + 1);
+            }
+            _label[u] = new_label;
+            _current[u] = _g->begin(u);
+            if (new_label >= _n)
+                return;
+            add_to_layer(u);
+        }
+    }
+
+public:
+    push_relabel() = default;
+
+    // Compute a maximum s-t flow value and a minimum s-t cut of g
+    void run(csr_graph const& g, int s, int t)
+    {
+        _g = &g;
+        _n = g.n_nodes();
+        _s = s;
+        _t = t;
+
+        // Reset the workspace: fully if the graph changed, otherwise only
+        // the nodes the previous run has touched
+        if (_graph_stamp != g.stamp() || _res.size() < std::size_t(g.n_arcs()) ||
+            _excess.size() < std::size_t(_n))
+        {
+            _graph_stamp = g.stamp();
+            std::size_t n = std::max(_excess.size(), std::size_t(_n));
+            _res.assign(g.capacities(), g.capacities() + g.n_arcs());
+            _excess.assign(n, 0);
+            _label.resize(n);
+            _current.resize(n);
+            _active_head.resize(n + 1);
+            _active_next.resize(n);
+            _layer_head.resize(n + 1);
+            _layer_next.resize(n);
+            _layer_prev.resize(n);
+            _is_dirty.assign(n, 0);
+            _dirty.clear();
+        }
+        else
+        {
+            int const* capacities = g.capacities();
+            for (int u : _dirty)
+            {
+                std::copy(capacities + g.begin(u), capacities + g.end(u),
+                    _res.begin() + g.begin(u));
+                _excess[u] = 0;
+                _is_dirty[u] = 0;
+            }
+            _dirty.clear();
+        }
+
+        // Saturate the arcs out of s
+        int const* targets = g.targets();
+        int const* reverses = g.reverses();
+        mark_dirty(s);
+        for (int a = g.begin(s); a < g.end(s); ++a)
+        {
+            int delta = _res[a];
+            if (delta == 0)
+                continue;
+            int v = targets[a];
+            _res[a] = 0;
+            _res[reverses[a]] += delta;
+            mark_dirty(v);
+            _excess[v] += delta;
+        }
+
+        global_relabel();
+
+        std::size_t relabels_at_global = _n_relabels;
+        while (_max_active >= 0)
+        {
+            int u = _active_head[_max_active];
+            if (u == -1)
+            {
+                --_max_active;
+                continue;
+            }
+            _active_head[_max_active] = _active_next[u];
+
+            discharge(u);
+
+            if (_n_relabels - relabels_at_global > std::size_t(_n))
+            {
+                global_relabel();
+                relabels_at_global = _n_relabels;
+            }
+        }
+
+        _flow = _excess[t];
+
+        // The source side is the set of nodes that cannot reach t
+        global_relabel();
+        _source_side.assign((_n + 63) / 64, 0);
+        for (int u = 0; u < _n; ++u)
+        {
+            if (_label[u] == _n)
+                _source_side[u / 64] |= std::uint64_t(1) << (u % 64);
+        }
+    }
+
+    flow_type flow_value() const
+    {
+        return _flow;
+    }
+
+    // True if u is on the source side of the minimum cut
+    bool min_cut(int u) const
+    {
+        return (_source_side[u / 64] >> (u % 64)) & 1;
+    }
+
+    // The source side of the minimum cut as a bitset: bit u % 64 of word u / 64
+    std::vector<std::uint64_t> const& source_side() const
+    {
+        return _source_side;
+    }
+
+    std::size_t n_pushes() const
+    {
+        return _n_pushes;
+    }
+
+    std::size_t n_relabels() const
+    {
+        return _n_relabels;
+    }
+
+    std::size_t n_global_relabels() const
+    {
+        return _n_global_relabels;
+    }
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// A cursor over graph file text, held in memory (see mapped_file).
+// Numbers are parsed in place with std::from_chars: no line is copied and
+// nothing is allocated.
+class text_scanner
+{
+    char const* _p;
+    char const* _end;
+
+public:
+    text_scanner(char const* first, char const* last)
+      : _p(first)
+      , _end(last)
+    {
+    }
+
+    bool at_end() const
+    {
+        return _p == _end;
+    }
+
+    char const* position() const
+    {
+        return _p;
+    }
+
+    // The next character, or '\0' at the end
+    char peek() const
+    {
+        return _p != _end ? *_p : '\0';
+    }
+
+    void advance(std::size_t n = 1)
+    {
+        _p += std::min(n, std::size_t(_end - _p));
+    }
+
+    bool starts_with(std::string_view s) const
+    {
+        return std::size_t(_end - _p) >= s.size() &&
+            std::memcmp(_p, s.data(), s.size()) == 0;
+    }
+
+    // Skip spaces and tabs, and the '\r' of Windows line ends
+    void skip_blanks()
+    {
+        while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\r'))
+            ++_p;
+    }
+
+    // Skip past the end of the current line
+    void skip_line()
+    {
+        if (_p == _end)
+            return;
+        char const* nl = static_cast<char const*>(
+            std::memchr(_p, '\n', std::size_t(_end - _p)));
+        _p = nl ? nl + 1 : _end;
+    }
+
+    // Skip lines that are blank or start with comment
+    void skip_lines(char comment)
+    {
+        while (true)
+        {
+            char const* line = _p;
+            skip_blanks();
+            if (_p != _end && (*_p == '\n' || *_p == comment))
+            {
+                skip_line();
+                continue;
+            }
+            _p = line;
+            return;
+        }
+    }
+
+    // True if only blanks are left on the current line
+    bool at_line_end()
+    {
+        skip_blanks();
+        return _p == _end || *_p == '\n';
+    }
+
+    // Parse the next number on the current line
+    template <typename T>
+    bool read(T& value)
+    {
+        skip_blanks();
+        auto [next, ec] = std::from_chars(_p, _end, value);
+        if (ec != std::errc())
+            return false;
+        _p = next;
+        return true;
+    }
+};
+
+// Files are parsed in chunks of at least this many bytes, at most four
+// chunks per thread
+inline constexpr std::size_t parse_chunk_min_bytes = std::size_t(1) << 18;
+
+// Parse the m entries (edges) of the body [first, last) of a graph file.
+// Lines that are blank or start with comment are skipped, and lines after
+// the m-th entry are ignored. parse_entry(text_scanner&, csr_graph::edge&)
+// parses the entry at the start of a line, and returns false if it is
+// invalid. Returns false on an invalid entry or if there are fewer than m.
+//
+// With several threads, the body is split at line starts into chunks,
+// which are parsed concurrently into buffers of their own, and the buffers
+// are concatenated in file order. The edges are the same as with one thread.
+template <typename ParseEntry>
+bool parse_entries(char const* first, char const* last, int m, char comment,
+    ParseEntry parse_entry, std::vector<csr_graph::edge>& edges,
+    unsigned n_threads = 1)
+{
+    std::size_t const size = std::size_t(last - first);
+    std::size_t const n_chunks =
+        std::min(std::size_t(4) * n_threads, size / parse_chunk_min_bytes);
+
+    edges.clear();
+
+    if (n_threads <= 1 || n_chunks <= 1)
+    {
+        edges.reserve(m);
+        text_scanner in(first, last);
+        for (int i = 0; i < m; ++i)
+        {
+            in.skip_lines(comment);
+            csr_graph::edge e;
+            if (in.at_end() || !parse_entry(in, e))
+                return false;
+            in.skip_line();
+            edges.push_back(e);
+        }
+        return true;
+    }
+
+    // Chunk i is [bounds[i], bounds[i + 1]), and starts at a line start
+    std::vector<char const*> bounds(n_chunks + 1);
+    bounds[0] = first;
+    bounds[n_chunks] = last;
+    for (std::size_t i = 1; i < n_chunks; ++i)
+    {
+        char const* p = std::max(first + size * i / n_chunks, bounds[i - 1]);
+        text_scanner in(p, last);
+        if (p[-1] != '\n')
+            in.skip_line();
+        bounds[i] = in.position();
+    }
+
+    struct chunk
+    {
+        std::vector<csr_graph::edge> edges;
+        // False if the chunk has an invalid entry after its edges
+        bool ok = true;
+    };
+    std::vector<chunk> chunks(n_chunks);
+
+    thread_pool pool(n_threads);
+    pool.parallel_for(n_chunks, [&](std::size_t i, unsigned) {
+        chunk& c = chunks[i];
+        c.edges.reserve(std::size_t(m) * (bounds[i + 1] - bounds[i]) / size);
+        text_scanner in(bounds[i], bounds[i + 1]);
+        while (true)
+        {
+            in.skip_lines(comment);
+            if (in.at_end())
+                break;
+            csr_graph::edge e;
+            if (!parse_entry(in, e))
+            {
+                c.ok = false;
+                break;
+            }
+            in.skip_line();
+            c.edges.push_back(e);
+        }
+    });
+
+    // Only the chunks up to the m-th entry count, as for a serial parse
+    std::vector<std::size_t> offsets{0};
+    for (chunk const& c : chunks)
+    {
+        if (offsets.back() >= std::size_t(m))
+            break;
+        offsets.push_back(offsets.back() + c.edges.size());
+        if (!c.ok && offsets.back() < std::size_t(m))
+            return false;
+    }
+    if (offsets.back() < std::size_t(m))
+        return false;
+
+    edges.resize(m);
+    pool.parallel_for(offsets.size() - 1, [&](std::size_t i, unsigned) {
+        std::size_t n = std::min(chunks[i].edges.size(), m - offsets[i]);
+        std::copy_n(chunks[i].edges.begin(), n, edges.begin() + offsets[i]);
+    });
+    return true;
+}
+
+// Fill graph with n_nodes nodes and the given edges (0-based), weighted by
+// arc_map. Storage for both is reserved first.
+template <typename Graph, typename ArcMap>
+void fill_graph(Graph& graph, ArcMap& arc_map, int n_nodes,
+    std::vector<csr_graph::edge> const& edges)
+{
+    graph.clear();
+    graph.reserveNode(n_nodes);
+    graph.reserveEdge(static_cast<int>(edges.size()));
+
+    for (int i = 0; i < n_nodes; ++i)
+    {
+        graph.addNode();
+    }
+    for (csr_graph::edge const& e : edges)
+    {
+        auto f = graph.addEdge(graph.nodeFromId(e.u), graph.nodeFromId(e.v));
+        arc_map[f] = e.weight;
+    }
+}
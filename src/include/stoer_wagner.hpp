@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "csr_graph.hpp"
+
+// The global min cut of an undirected graph, by maximum adjacency orders as
+// in the Stoer-Wagner algorithm, with the contractions of Nagamochi, Ono and
+// Ibaraki: instead of merging only the last two nodes of an order, a round
+// merges every edge that the order proves to be inside a cut no smaller
+// than the best one found so far.
+//
+// When an order reaches the arc u->v, the key of v is a lower bound of the
+// min u-v cut, and if it is at least the best cut, u and v are merged. The
+// last two nodes of an order are always merged. The best cut is the
+// smallest degree of a merged node over the rounds. A round runs on the
+// merged graph, rebuilt with its parallel edges summed, and costs
+// O(m' log m') for the m' edges left. There can be n - 1 rounds, but on the
+// random graphs of data/ one to four rounds leave a single node, and a run
+// costs a small fraction of the n - 1 flows of a tree.
+class stoer_wagner
+{
+    long long _value = 0;
+    std::vector<char> _side;
+
+    // The merged node of each node
+    std::vector<int> _label;
+
+    // The merged graph of a round, in CSR layout, with each edge stored
+    // both ways
+    std::vector<int> _offsets;
+    std::vector<int> _targets;
+    std::vector<long long> _weights;
+
+    // Workspace of a round, by merged node
+    std::vector<long long> _key;
+    std::vector<char> _added;
+    std::vector<int> _root;
+    std::vector<int> _renumber;
+    // Weight to each neighbor, while the edges of a node are summed
+    std::vector<long long> _sum;
+    std::vector<int> _touched;
+
+    struct edge
+    {
+        int u;
+        int v;
+        long long weight;
+    };
+
+    int find(int u)
+    {
+        while (_root[u] != u)
+        {
+            _root[u] = _root[_root[u]];
+            u = _root[u];
+        }
+        return u;
+    }
+
+    // Build the merged graph of n nodes from edges, summing parallel edges
+    void build(int n, std::vector<edge> const& edges)
+    {
+        std::vector<int> first(n + 1, 0);
+        for (edge const& e : edges)
+        {
+            ++first[e.u + 1];
+            ++first[e.v + 1];
+        }
+        for (int u = 0; u < n; ++u)
+        {
+            first[u + 1] += first[u];
+        }
+        std::vector<int> targets(first[n]);
+        std::vector<long long> weights(first[n]);
+        std::vector<int> fill(first.begin(), first.end() - 1);
+        for (edge const& e : edges)
+        {
+            targets[fill[e.u]] = e.v;
+            weights[fill[e.u]++] = e.weight;
+            targets[fill[e.v]] = e.u;
+            weights[fill[e.v]++] = e.weight;
+        }
+
+        _offsets.assign(1, 0);
+        _targets.clear();
+        _weights.clear();
+        _sum.assign(n, 0);
+        for (int u = 0; u < n; ++u)
+        {
+            for (int a = first[u]; a < first[u + 1]; ++a)
+            {
+                if (_sum[targets[a]] == 0)
+                    _touched.push_back(targets[a]);
+                _sum[targets[a]] += weights[a];
+            }
+            for (int v : _touched)
+            {
+                _targets.push_back(v);
+                _weights.push_back(_sum[v]);
+                _sum[v] = 0;
+            }
+            _touched.clear();
+            _offsets.push_back(static_cast<int>(_targets.size()));
+        }
+    }
+
+    // Put the nodes with label u on one side
+    void record_side(int u)
+    {
+        for (std::size_t x = 0; x < _side.size(); ++x)
+        {
+            _side[x] = _label[x] == u;
+        }
+    }
+
+public:
+    stoer_wagner() = default;
+
+    // Compute the min cut of g. A graph with less than two nodes has no cut,
+    // and gets the value 0 with every node on one side.
+    void run(csr_graph const& g)
+    {
+        int const n = g.n_nodes();
+        _value = std::numeric_limits<long long>::max();
+        _side.assign(n, 0);
+        if (n < 2)
+        {
+            _value = 0;
+            return;
+        }
+
+        _label.resize(n);
+        std::iota(_label.begin(), _label.end(), 0);
+        std::vector<edge> edges;
+        for (int u = 0; u < n; ++u)
+        {
+            for (int a = g.begin(u); a < g.end(u); ++a)
+            {
+                if (u < g.target(a) && g.capacity(a) > 0)
+                    edges.push_back({u, g.target(a), g.capacity(a)});
+            }
+        }
+
+        std::priority_queue<std::pair<long long, int>> queue;
+        for (int n_left = n; n_left > 1;)
+        {
+            build(n_left, edges);
+
+            // The cut around each merged node
+            for (int u = 0; u < n_left; ++u)
+            {
+                long long degree = 0;
+                for (int a = _offsets[u]; a < _offsets[u + 1]; ++a)
+                {
+                    degree += _weights[a];
+                }
+                if (degree < _value)
+                {
+                    _value = degree;
+                    record_side(u);
+                }
+            }
+            if (_value == 0 || n_left == 2)
+                break;
+
+            // Grow a maximum adjacency order, and merge the ends of the arcs
+            // whose target had a key of at least the best cut once they were
+            // scanned. Stale queue entries, whose key has grown since, are
+            // skipped.
+            _key.assign(n_left, 0);
+            _added.assign(n_left, 0);
+            _root.resize(n_left);
+            std::iota(_root.begin(), _root.end(), 0);
+            int s = -1;
+            int t = 0;
+            int n_added = 0;
+            queue.emplace(0, t);
+            while (!queue.empty())
+            {
+                auto [key, u] = queue.top();
+                queue.pop();
+                if (_added[u] || key != _key[u])
+                    continue;
+                _added[u] = 1;
+                ++n_added;
+                s = t;
+                t = u;
+                for (int a = _offsets[u]; a < _offsets[u + 1]; ++a)
+                {
+                    int v = _targets[a];
+                    if (!_added[v])
+                    {
+                        _key[v] += _weights[a];
+                        queue.emplace(_key[v], v);
+                        if (_key[v] >= _value)
+                            _root[find(u)] = find(v);
+                    }
+                }
+            }
+
+            // Nodes not reached are cut off from the others for free
+            if (n_added < n_left)
+            {
+                // Those reached are one side
+                _value = 0;
+                for (int x = 0; x < n; ++x)
+                {
+                    _side[x] = _added[_label[x]];
+                }
+                break;
+            }
+            _root[find(s)] = find(t);
+
+            // Number the merged nodes, and sum the edges between them in the
+            // next round
+            _renumber.assign(n_left, -1);
+            int n_merged = 0;
+            for (int u = 0; u < n_left; ++u)
+            {
+                if (find(u) == u)
+                    _renumber[u] = n_merged++;
+            }
+            for (int x = 0; x < n; ++x)
+            {
+                _label[x] = _renumber[find(_label[x])];
+            }
+            edges.clear();
+            for (int u = 0; u < n_left; ++u)
+            {
+                for (int a = _offsets[u]; a < _offsets[u + 1]; ++a)
+                {
+                    int v = _targets[a];
+                    if (u < v && find(u) != find(v))
+                    {
+                        edges.push_back({_renumber[find(u)],
+                            _renumber[find(v)], _weights[a]});
+                    }
+                }
+            }
+            n_left = n_merged;
+        }
+    }
+
+    // The value of the min cut
+    long long value() const
+    {
+        return _value;
+    }
+
+    // The sides of the min cut: true for the nodes of one of them
+    bool side(int u) const
+    {
+        return _side[u] != 0;
+    }
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "util.hpp"
+
+// A fixed-size, work-stealing pool of worker threads.
+// Tasks receive the index of the worker that runs them, so that callers can
+// keep per-worker scratch data (graph copies, flow workspaces...) without locking.
+//
+// Every worker owns a deque. A task submitted from inside a worker goes to the
+// back of that worker's deque, and the worker pops from the back, so recursive
+// work is processed depth-first and stays cache-local. Idle workers steal from
+// the front of the other deques, which holds the oldest (largest) tasks.
+//
+// With perf_counters enabled, each worker adds what it counted to the
+// counters of the thread that made the pool when it finishes.
+class thread_pool
+{
+public:
+    using task = std::function<void(unsigned)>;
+
+private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::thread> _workers;
+    std::vector<std::unique_ptr<worker_queue>> _queues;
+
+    // Guards sleeping and waking up workers, and waiting for completion
+    std::mutex _mutex;
+    std::condition_variable _cv_task;
+    std::condition_variable _cv_done;
+    // Number of tasks sitting in the deques
+    std::size_t _n_queued = 0;
+    // Number of submitted tasks that have not finished yet
+    std::atomic<std::size_t> _pending{0};
+    // Where tasks submitted from outside the pool go next
+    std::size_t _next_queue = 0;
+    std::exception_ptr _error;
+    bool _stop = false;
+    // The counters of the thread that made the pool, or null
+    perf_counters* _parent = nullptr;
+
+    // The pool and worker index of the calling thread, if it is a worker
+    static inline thread_local thread_pool* _current_pool = nullptr;
+    static inline thread_local unsigned _current_worker = 0;
+
+    bool pop_back(unsigned worker, task& f)
+    {
+        worker_queue& q = *_queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            return false;
+        f = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned thief, task& f)
+    {
+        for (std::size_t i = 1; i < _queues.size(); ++i)
+        {
+            worker_queue& q = *_queues[(thief + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty())
+            {
+                f = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(unsigned worker)
+    {
+        _current_pool = this;
+        _current_worker = worker;
+        perf_sample start;
+        if (_parent)
+            start = perf_counters::this_thread().read();
+
+        while (true)
+        {
+            task f;
+            if (!pop_back(worker, f) && !steal(worker, f))
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv_task.wait(lock, [&] { return _stop || _n_queued > 0; });
+                if (_stop && _n_queued == 0)
+                {
+                    if (_parent)
+                    {
+                        _parent->add_children(
+                            perf_counters::this_thread().read() - start);
+                    }
+                    return;
+                }
+                // Some deque has work, go look for it
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_n_queued;
+            }
+
+            try
+            {
+                f(worker);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_error)
+                    _error = std::current_exception();
+            }
+
+            if (--_pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _cv_done.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit thread_pool(unsigned n_threads = default_threads())
+    {
+        n_threads = std::max(1u, n_threads);
+        if (perf_counters::enabled())
+            _parent = &perf_counters::this_thread();
+        for (unsigned i = 0; i < n_threads; ++i)
+        {
+            _queues.push_back(std::make_unique<worker_queue>());
+        }
+        _workers.reserve(n_threads);
+        for (unsigned i = 0; i < n_threads; ++i)
+        {
+            _workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    thread_pool(thread_pool const&) = delete;
+    thread_pool& operator=(thread_pool const&) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv_task.notify_all();
+        for (auto& w : _workers)
+        {
+            w.join();
+        }
+    }
+
+    // Number of hardware threads, or 1 if that cannot be determined
+    static unsigned default_threads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(_workers.size());
+    }
+
+    // Queue a task. Called from one of our workers, the task goes to that
+    // worker's own deque; otherwise the deques are filled round-robin.
+    void submit(task f)
+    {
+        ++_pending;
+
+        {
+            // The task is counted once it can be taken, so that a woken
+            // worker always finds it, and taken tasks are never counted
+            // before they are queued
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::size_t target = _current_pool == this
+                ? _current_worker
+                : _next_queue++ % _queues.size();
+            {
+                worker_queue& q = *_queues[target];
+                std::lock_guard<std::mutex> queue_lock(q.mutex);
+                q.tasks.push_back(std::move(f));
+            }
+            ++_n_queued;
+        }
+        _cv_task.notify_one();
+    }
+
+    // Block until every submitted task, including the ones submitted by
+    // other tasks, has finished. Must not be called from a worker.
+    // Rethrows the first exception thrown by a task, if any.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv_done.wait(lock, [&] { return _pending == 0; });
+        if (_error)
+        {
+            std::exception_ptr e = _error;
+            _error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    // Run f(worker) once on every worker, and wait for all of them. Must not
+    // be called from a worker.
+    template <typename F>
+    void for_each_worker(F f)
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::size_t n_started = 0;
+        for (std::size_t i = 0; i < _workers.size(); ++i)
+        {
+            submit([&](unsigned worker) {
+                // Hold every worker until all have a task, so that none
+                // takes two
+                std::unique_lock<std::mutex> lock(mutex);
+                if (++n_started == _workers.size())
+                    cv.notify_all();
+                cv.wait(lock, [&] { return n_started == _workers.size(); });
+                lock.unlock();
+                f(worker);
+            });
+        }
+        wait();
+    }
+
+    // Run f(i, worker) for every i in [0, n), and wait for all of them
+    template <typename F>
+    void parallel_for(std::size_t n, F f)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            submit([i, &f](unsigned worker) { f(i, worker); });
+        }
+        wait();
+    }
+};
@@ -1,8 +1,20 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 class timer
 {
@@ -27,19 +39,285 @@ public:
     }
 };
 
+// Hardware event counts of a span of a thread. available is false if they
+// could not be counted.
+struct perf_sample
+{
+    std::uint64_t cycles = 0;
+    std::uint64_t instructions = 0;
+    std::uint64_t llc_misses = 0;
+    std::uint64_t branch_misses = 0;
+    bool available = false;
+
+    perf_sample& operator+=(perf_sample const& other)
+    {
+        cycles += other.cycles;
+        instructions += other.instructions;
+        llc_misses += other.llc_misses;
+        branch_misses += other.branch_misses;
+        available = available || other.available;
+        return *this;
+    }
+
+    perf_sample operator-(perf_sample const& start) const
+    {
+        perf_sample d;
+        d.cycles = cycles - start.cycles;
+        d.instructions = instructions - start.instructions;
+        d.llc_misses = llc_misses - start.llc_misses;
+        d.branch_misses = branch_misses - start.branch_misses;
+        d.available = available && start.available;
+        return d;
+    }
+};
+
+// The hardware counters of the calling thread, by perf_event_open on Linux:
+// cycles, instructions, last level cache misses and branch misses, in user
+// space. The workers of a thread pool add their own counts to those of the
+// thread that made the pool when they finish, so reads also count the pools
+// the thread has run, such as those of read and simplify. They are off
+// unless enabled before the first use, and where perf_event_open fails
+// (other systems, perf_event_paranoid, containers, virtual machines) reads
+// give unavailable samples, and only times are logged. Counts are scaled
+// when the kernel multiplexes the counters.
+class perf_counters
+{
+    static constexpr int n_events = 4;
+    // The group leader, then the other events, or -1
+    std::array<int, n_events> _fds{-1, -1, -1, -1};
+    // Position of each event in a group read, or -1 if it did not open
+    std::array<int, n_events> _index{-1, -1, -1, -1};
+    int _n_open = 0;
+    // What finished pool workers added
+    mutable std::mutex _children_mutex;
+    perf_sample _children;
+
+    perf_counters()
+    {
+#if defined(__linux__)
+        if (!enabled())
+            return;
+        std::uint64_t const llc_read_miss = PERF_COUNT_HW_CACHE_LL |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        std::array<std::pair<std::uint32_t, std::uint64_t>, n_events> const
+            events{{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, llc_read_miss},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}}};
+        for (int e = 0; e < n_events; ++e)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[e].first;
+            attr.config = events[e].second;
+            attr.disabled = _fds[0] == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP |
+                PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0,
+                -1, _fds[0], PERF_FLAG_FD_CLOEXEC));
+            if (fd == -1)
+            {
+                // Without cycles there is no group
+                if (e == 0)
+                    return;
+                continue;
+            }
+            _fds[e] = fd;
+            _index[e] = _n_open++;
+        }
+        ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+public:
+    ~perf_counters()
+    {
+#if defined(__linux__)
+        for (int fd : _fds)
+        {
+            if (fd != -1)
+                close(fd);
+        }
+#endif
+    }
+
+    perf_counters(perf_counters const&) = delete;
+    perf_counters& operator=(perf_counters const&) = delete;
+
+    // Count events from now on; set before any thread uses the counters
+    static bool& enabled()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    // The counters of the calling thread, opened on its first call
+    static perf_counters& this_thread()
+    {
+        static thread_local perf_counters counters;
+        return counters;
+    }
+
+    bool available() const
+    {
+        return _n_open > 0;
+    }
+
+    // Add the counts of a thread that worked for this one
+    void add_children(perf_sample const& counts)
+    {
+        std::lock_guard<std::mutex> lock(_children_mutex);
+        _children += counts;
+    }
+
+    // The counts since the counters were opened, with those added by
+    // add_children
+    perf_sample read() const
+    {
+        perf_sample sample;
+#if defined(__linux__)
+        if (!available())
+            return sample;
+        {
+            std::lock_guard<std::mutex> lock(_children_mutex);
+            sample = _children;
+        }
+        // nr, time enabled, time running, then the values
+        std::array<std::uint64_t, 3 + n_events> data{};
+        if (::read(_fds[0], data.data(), sizeof(data)) <= 0)
+            return perf_sample();
+        double scale = data[2] > 0 && data[2] < data[1]
+            ? double(data[1]) / double(data[2])
+            : 1.0;
+        auto value = [&](int e) -> std::uint64_t {
+            return _index[e] == -1
+                ? 0
+                : static_cast<std::uint64_t>(
+                      double(data[3 + _index[e]]) * scale);
+        };
+        sample.cycles += value(0);
+        sample.instructions += value(1);
+        sample.llc_misses += value(2);
+        sample.branch_misses += value(3);
+        sample.available = true;
+#endif
+        return sample;
+    }
+};
+
+// The hardware events of the calling thread, and of the pool workers that
+// finished for it, between ticks, as timer measures time
+class perf_scope
+{
+    perf_sample _start;
+
+public:
+    perf_scope() : _start(perf_counters::this_thread().read())
+    {
+    }
+
+    // Return the events since the last call to this function, or since the
+    // scope was created
+    perf_sample tick()
+    {
+        perf_sample now = perf_counters::this_thread().read();
+        perf_sample d = now - _start;
+        _start = now;
+        return d;
+    }
+};
+
+// A JSON record of key-value pairs, written to stdout when it is destroyed.
+// A thread can redirect what it adds to any logger into another one, so that
+// code logging to global_json_logger fills the record of the job it runs,
+// or drop it, so that code run many times logs nothing.
 class json_logger
 {
     std::vector<std::pair<std::string, std::string>> _data;
+    bool _write_on_exit = true;
+
+    static json_logger*& target()
+    {
+        static thread_local json_logger* target = nullptr;
+        return target;
+    }
+
+    static bool& discarding()
+    {
+        static thread_local bool discarding = false;
+        return discarding;
+    }
 
 public:
+    json_logger() = default;
+    explicit json_logger(bool write_on_exit) : _write_on_exit(write_on_exit)
+    {
+    }
+
+    // Redirect the adds of the calling thread to a logger, while it lives
+    class redirect
+    {
+        json_logger* _previous;
+
+    public:
+        explicit redirect(json_logger& logger) : _previous(target())
+        {
+            target() = &logger;
+        }
+        ~redirect()
+        {
+            target() = _previous;
+        }
+        redirect(redirect const&) = delete;
+        redirect& operator=(redirect const&) = delete;
+    };
+
+    // Drop the adds of the calling thread to any logger, while it lives
+    class discard
+    {
+        bool _previous;
+
+    public:
+        discard() : _previous(discarding())
+        {
+            discarding() = true;
+        }
+        ~discard()
+        {
+            discarding() = _previous;
+        }
+        discard(discard const&) = delete;
+        discard& operator=(discard const&) = delete;
+    };
+
     void add(std::string key, std::string value)
     {
-        _data.emplace_back(key, value);
+        if (discarding())
+            return;
+        json_logger* logger = target() ? target() : this;
+        logger->_data.emplace_back(key, value);
     }
     template <typename T>
     void add(std::string key, T value)
     {
-        _data.emplace_back(key, std::to_string(value));
+        if (discarding())
+            return;
+        add(key, std::to_string(value));
+    }
+    // The counts of a phase as <prefix>_cycles, _instructions, _llc_misses
+    // and _branch_misses, if they are available
+    void add_counts(std::string const& prefix, perf_sample const& counts)
+    {
+        if (!counts.available)
+            return;
+        add(prefix + "_cycles", counts.cycles);
+        add(prefix + "_instructions", counts.instructions);
+        add(prefix + "_llc_misses", counts.llc_misses);
+        add(prefix + "_branch_misses", counts.branch_misses);
     }
     void write(std::ostream& os = std::cout)
     {
@@ -55,9 +333,11 @@ public:
         os << "}" << std::endl;
     }
 
+    // An empty record is not written
     ~json_logger()
     {
-        write();
+        if (_write_on_exit && !_data.empty())
+            write();
     }
 };
 
@@ -1,129 +1,622 @@
+#include <cstdint>
 #include <iostream>
 #include <lemon/bfs.h>
 #include <lemon/lgf_reader.h>
 #include <lemon/list_graph.h>
-#include <set>
+#include <sstream>
+#include "batch.hpp"
+#include "boykov_kolmogorov.hpp"
 #include "dimacs_reader.hpp"
+#include "dinic.hpp"
 #include "dot_writer.hpp"
+#include "edge_list.hpp"
+#include "gomory_hu_tree.hpp"
+#include "graph_cache.hpp"
 #include "k_min_cut.hpp"
+#include "karger_stein.hpp"
+#include "lemon_preflow.hpp"
+#include "pseudoflow.hpp"
+#include "push_relabel.hpp"
 #include "util.hpp"
 
 using namespace lemon;
 
-void preprocess_graph(ListGraph& g, ListGraph::EdgeMap<int>& weights)
+// True if every node of g can be reached from the first one
+bool is_connected(ListGraph const& g)
 {
-    // We need to do some preprocessing:
-    // 1. Remove self-loops and parallel edges
-    // 2. Make the graph connected
-    // This is done by doing successively doing BFS, and connecting random
-    // unvisited nodes until all can be reached from the root node
-    int n_edges_erased = 0;
-    int n_edges_added = 0;
-
-    // Remove loops and parallel edges
+    ListGraph::NodeIt root(g);
+    if (root == INVALID)
+        return true;
+    lemon::Bfs<ListGraph> bfs(g);
+    bfs.run(root);
     for (ListGraph::NodeIt n(g); n != INVALID; ++n)
     {
-        // Avoid removing edges while iterating over them
-        std::vector<ListGraph::Edge> edges_to_remove;
-        std::set<ListGraph::Node> visited;
-        for (ListGraph::IncEdgeIt e(g, n); e != INVALID; ++e)
-        {
-            ListGraph::Node u = g.u(e);
-            ListGraph::Node v = g.v(e);
-            // Not sure which is which
-            if (v == n)
-                std::swap(u, v);
-            if (u == v)
-            {
-                edges_to_remove.push_back(e);
-            }
-            else if (visited.find(v) != visited.end())
-            {
-                // Remove edge
-                edges_to_remove.push_back(e);
-            }
-            else
+        if (!bfs.reached(n))
+            return false;
+    }
+    return true;
+}
+
+// Options of a run of the pipeline, from the command line
+struct run_options
+{
+    std::string maxflow = "push-relabel";
+    std::string engine = "gomory-hu";
+    unsigned n_threads = 1;
+    bool reduce = true;
+    // Build the tree block by block. Disconnected graphs always are.
+    bool blocks = false;
+    // The min k-cut values are computed for k = 2..k, and the map for k
+    unsigned int k = 3;
+    // Where to save the Gomory-Hu tree, if not empty
+    std::string tree_file;
+    // The k of the maps written to cut_maps.txt, if any
+    std::vector<unsigned int> map_ks;
+    // Where to save the dendrogram of the tree, if not empty
+    std::string dendrogram_file;
+    // The trials and seed of the Karger-Stein engine
+    unsigned n_trials = 64;
+    std::uint64_t seed = 1;
+    // The lambda of the sparse certificate, or "auto", if not empty. Only
+    // the min k-cut values up to k are exact on it, so it excludes the tree
+    // outputs.
+    std::string certificate;
+    // Where to write the graph cache instead of running, if not empty
+    std::string cache_file;
+    // In batch mode nothing is printed or written but the JSON records
+    bool batch = false;
+};
+
+// True if only the min 2-cut is asked for, and nothing needs the tree, so
+// that Stoer-Wagner finds it instead
+bool stoer_wagner_cut(run_options const& options)
+{
+    return options.engine == "gomory-hu" && options.k == 2 &&
+        options.tree_file.empty() && options.map_ks.empty() &&
+        options.dendrogram_file.empty();
+}
+
+template <typename MaxFlow>
+void run_k_min_cut(
+    ListGraph& g, ListGraph::EdgeMap<int>& weights, run_options const& options)
+{
+    k_min_cut<MaxFlow> kmc(g, weights);
+    kmc.set_threads(options.n_threads);
+    kmc.set_reduction(options.reduce);
+
+    if (stoer_wagner_cut(options))
+    {
+        ListGraph::NodeMap<unsigned int> cut_colors(g);
+        long long value = kmc.run_min_cut(cut_colors);
+        global_json_logger.add("min_cut_engine", std::string("stoer-wagner"));
+        global_json_logger.add("min_k_cut_values", value);
+
+        // write original graph to dot file
+        if (!options.batch)
+        {
+            std::ofstream dot_file("graph.dot");
+            writeDotGraph(g, weights, dot_file);
+        }
+        return;
+    }
+
+    //kmc.run_gomory_hu();
+    if (options.blocks)
+        kmc.run_gomory_hu_blocks();
+    else
+        kmc.run_gomory_hu_2();
+    kmc.min_k_cut_value(options.k);
+
+    // The whole curve, for k = 2..k
+    std::string values;
+    auto k_values = kmc.min_k_cut_values(options.k);
+    for (unsigned int k = 2; k <= options.k; ++k)
+    {
+        values += (k > 2 ? " " : "") + std::to_string(k_values[k]);
+    }
+    global_json_logger.add("min_k_cut_values", values);
+
+    if (!options.tree_file.empty())
+    {
+        gomory_hu_tree tree;
+        tree.build(kmc._tree, kmc._tree_flows, kmc._tree_labels);
+        tree.write(options.tree_file);
+    }
+
+    ListGraph::NodeMap<unsigned int> cut_colors(g);
+    kmc.min_k_cut_map(options.k, cut_colors);
+
+    if (!options.map_ks.empty())
+    {
+        // One line per node: its id, then its component for each k
+        ListGraph::NodeMap<std::vector<unsigned int>> cut_maps(g);
+        kmc.min_k_cut_maps(options.map_ks, cut_maps);
+        std::ofstream maps_file("cut_maps.txt");
+        maps_file << "node";
+        for (unsigned int k : options.map_ks)
+        {
+            maps_file << " k" << k;
+        }
+        maps_file << "\n";
+        for (ListGraph::NodeIt n(g); n != INVALID; ++n)
+        {
+            maps_file << g.id(n);
+            for (unsigned int label : cut_maps[n])
             {
-                visited.insert(v);
+                maps_file << " " << label;
             }
+            maps_file << "\n";
         }
-        for (auto& e : edges_to_remove)
+    }
+
+    if (!options.dendrogram_file.empty())
+    {
+        // One line per merge: the two clusters, the flow and the size
+        std::ofstream dendrogram_file(options.dendrogram_file);
+        for (auto const& m : kmc.dendrogram().merges())
         {
-            g.erase(e);
-            ++n_edges_erased;
+            dendrogram_file << m.a << " " << m.b << " " << m.flow << " "
+                            << m.size << "\n";
         }
     }
 
-    // Make the graph connected
-    ListGraph::Node root = g.nodeFromId(0);
-    lemon::Bfs<ListGraph> bfs(g);
+    if (options.batch)
+        return;
 
-    bfs.run(root);
+    // write original graph to dot file
+    std::ofstream dot_file("graph.dot");
+    writeDotGraph(g, weights, dot_file);
+    //writeDotGraph(g, weights);
 
-    for (ListGraph::NodeIt n(g); n != INVALID; ++n)
+    // write Gomory-Hu tree to dot file
+    std::ofstream dot_file_gh("graph_gh.dot");
+    writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels, dot_file_gh);
+    //writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels);
+}
+
+// Search the min k-cut by Karger-Stein trials instead of the Gomory-Hu tree
+void run_karger_stein(
+    ListGraph& g, ListGraph::EdgeMap<int>& weights, run_options const& options)
+{
+    csr_graph csr;
+    std::vector<ListGraph::Node> nodes;
+    csr.build(g, weights, nodes);
+    std::vector<csr_graph::edge> edges;
+    for (int u = 0; u < csr.n_nodes(); ++u)
     {
-        if (bfs.reached(n) == false)
+        for (int a = csr.begin(u); a < csr.end(u); ++a)
         {
-            // Connect n to root
-            // We expect a small number of non connected nodes, so hopefully this should't skew the original graph too much
-            ListGraph::Edge e = g.addEdge(root, n);
-            weights[e] = 42;
-            ++n_edges_added;
-            // Run BFS starting from n
-            // This should visit any nodes connected to n that were also not connected to the root
-            bfs.addSource(n);
-            bfs.start();
+            if (u < csr.target(a))
+                edges.push_back({u, csr.target(a), csr.capacity(a)});
         }
     }
 
-    std::cout << "Preprocessing: " << n_edges_erased << " edges erased, "
-              << n_edges_added << " edges added" << std::endl;
+    timer t_total;
+    karger_stein engine;
+    engine.set_threads(options.n_threads);
+    engine.set_trials(options.n_trials);
+    engine.set_seed(options.seed);
+    long long value = engine.run(csr.n_nodes(), edges, options.k);
+    global_json_logger.add("ks_time_total", t_total.tick());
+    global_json_logger.add("ks_threads", options.n_threads);
+    global_json_logger.add("ks_trials", options.n_trials);
+    global_json_logger.add("ks_seed", options.seed);
+    global_json_logger.add("min_k_cut_values", value);
+
+    ListGraph::NodeMap<unsigned int> cut_colors(g);
+    engine.cut_map(nodes, cut_colors);
+
+    // write original graph to dot file
+    if (!options.batch)
+    {
+        std::ofstream dot_file("graph.dot");
+        writeDotGraph(g, weights, dot_file);
+    }
 }
 
-int main(int argc, char** argv)
+// Answer queries on a saved Gomory-Hu tree, one per line, until the end of
+// the input or "quit". Nodes are graph node ids (from 0).
+//   cut <s> <t>   the min s-t cut value
+//   kcut <k>      the min k-cut value
+int serve_queries(std::string const& tree_file, std::istream& is = std::cin,
+    std::ostream& os = std::cout)
 {
-    if (argc == 1)
-    {
-        std::cout << "Benchmark of min-k-cut algorithm using Gomory-Hu Tree"
-                  << std::endl;
-        std::cout << "Usage: " << argv[0] << " <dimacs_matrix_file>"
-                  << std::endl;
+    timer t_load;
+    gomory_hu_tree tree;
+    if (!tree.read(tree_file))
         return 1;
+    global_json_logger.add("serve_time_load", t_load.tick());
+
+    std::string line;
+    std::size_t n_queries = 0;
+    while (std::getline(is, line))
+    {
+        std::istringstream query(line);
+        std::string command;
+        if (!(query >> command))
+            continue;
+        if (command == "quit")
+            break;
+        ++n_queries;
+        if (command == "cut")
+        {
+            int s, t;
+            if (!(query >> s >> t) || tree.node(s) == -1 || tree.node(t) == -1)
+            {
+                os << "error: usage: cut <s> <t>" << std::endl;
+                continue;
+            }
+            os << tree.min_cut(tree.node(s), tree.node(t)) << std::endl;
+        }
+        else if (command == "kcut")
+        {
+            unsigned int k;
+            if (!(query >> k) || k < 1 || int(k) > tree.n_nodes())
+            {
+                os << "error: usage: kcut <k>, 1 <= k <= n" << std::endl;
+                continue;
+            }
+            os << tree.min_k_cut_value(k) << std::endl;
+        }
+        else
+        {
+            os << "error: unknown command " << command << std::endl;
+        }
+    }
+    global_json_logger.add("serve_n_queries", n_queries);
+    return 0;
+}
+
+// Read a DIMACS file or a graph cache into a simple edge list on nodes
+// 0..n-1. Returns false if the file cannot be read.
+bool load_graph(std::string const& graph_file, run_options const& options,
+    int& n, std::vector<csr_graph::edge>& edges)
+{
+    timer t_read;
+    perf_scope p_read;
+    bool const from_cache = isGraphCache(graph_file);
+    if (from_cache)
+    {
+        // A graph cache holds a simple graph already
+        graph_cache cache;
+        if (!cache.open(graph_file))
+            return false;
+        n = cache.n_nodes();
+        cache.edges(edges);
+        global_json_logger.add("read_time", t_read.tick());
+        global_json_logger.add_counts("read", p_read.tick());
     }
+    else
+    {
+        if (!readDimacsEdges(graph_file, n, edges, options.n_threads))
+            return false;
+        global_json_logger.add("read_time", t_read.tick());
+        global_json_logger.add_counts("read", p_read.tick());
 
-    std::string graph_file = argv[1];
-    std::ifstream graph_fs(graph_file);
+        // Remove self-loops, and merge parallel and reverse arcs into one
+        // edge with their summed capacity
+        timer t_simplify;
+        perf_scope p_simplify;
+        simplify_stats stats = simplify_edges(n, edges, options.n_threads);
+        global_json_logger.add("simplify_time", t_simplify.tick());
+        global_json_logger.add_counts("simplify", p_simplify.tick());
+        global_json_logger.add("n_loops_removed", stats.n_loops);
+        global_json_logger.add("n_edges_merged", stats.n_merged);
+        if (!options.batch)
+            std::cout << "Preprocessing: " << stats.n_loops
+                      << " loops removed, " << stats.n_merged
+                      << " parallel edges merged" << std::endl;
+    }
+    global_json_logger.add("from_cache", from_cache);
+    return true;
+}
 
+// Run the pipeline on a graph loaded by load_graph. Returns the exit status.
+int run_graph(
+    int n, std::vector<csr_graph::edge>& edges, run_options const& options)
+{
+    // Keep only the edges that cuts of value up to lambda need. A cache is
+    // written before, so that it serves every lambda.
+    if (!options.certificate.empty() && options.cache_file.empty())
+    {
+        timer t_certificate;
+        long long lambda;
+        if (options.certificate == "auto")
+        {
+            // No min j-cut for j <= k is above this
+            lambda = singleton_k_cut_value(n, edges, options.k);
+        }
+        else
+        {
+            lambda = std::stoll(options.certificate);
+        }
+        std::size_t n_dropped = sparse_certificate(n, edges, lambda);
+        global_json_logger.add("certificate_time", t_certificate.tick());
+        global_json_logger.add("certificate_lambda", lambda);
+        global_json_logger.add("n_edges_certificate_dropped", n_dropped);
+        if (!options.batch)
+            std::cout << "Sparse certificate for " << lambda << ": "
+                      << n_dropped << " edges dropped" << std::endl;
+    }
     ListGraph g;
     ListGraph::EdgeMap<int> weights(g);
-    readDimacsGraph(g, weights, graph_fs);
+    fill_graph(g, weights, n, edges);
 
-    // Remove self-loops, double edges, and connect non-connected components
-    preprocess_graph(g, weights);
+    if (!options.cache_file.empty())
+    {
+        csr_graph csr;
+        std::vector<ListGraph::Node> nodes;
+        csr.build(g, weights, nodes);
+        return writeGraphCache(csr, options.cache_file) ? 0 : 1;
+    }
+
+    // The tree of the blocks joins the components by edges of flow 0, their
+    // actual cut. Stoer-Wagner and Karger-Stein handle them themselves.
+    run_options tree_options = options;
+    if (!options.blocks && options.engine == "gomory-hu" &&
+        !stoer_wagner_cut(options) && !is_connected(g))
+    {
+        tree_options.blocks = true;
+        if (!options.batch)
+            std::cout << "Preprocessing: disconnected graph, tree built by "
+                         "blocks"
+                      << std::endl;
+    }
 
     // Output number of nodes and edges
     global_json_logger.add("n_nodes", countNodes(g));
     global_json_logger.add("n_edges", countEdges(g));
 
     // Here begins the actual algorithm
-    k_min_cut kmc(g, weights);
+    global_json_logger.add("maxflow", options.maxflow);
+    global_json_logger.add("k", options.k);
+    global_json_logger.add("reduction", options.reduce);
+    global_json_logger.add("blocks", tree_options.blocks);
+    global_json_logger.add("engine", options.engine);
+    if (options.engine == "karger-stein")
+        run_karger_stein(g, weights, options);
+    else if (options.engine != "gomory-hu")
+    {
+        std::cerr << "Unknown engine: " << options.engine << std::endl;
+        return 1;
+    }
+    else if (options.maxflow == "push-relabel")
+        run_k_min_cut<push_relabel>(g, weights, tree_options);
+    else if (options.maxflow == "preflow")
+        run_k_min_cut<lemon_preflow>(g, weights, tree_options);
+    else if (options.maxflow == "dinic")
+        run_k_min_cut<dinic>(g, weights, tree_options);
+    else if (options.maxflow == "bk")
+        run_k_min_cut<boykov_kolmogorov>(g, weights, tree_options);
+    else if (options.maxflow == "pseudoflow")
+        run_k_min_cut<pseudoflow>(g, weights, tree_options);
+    else
+    {
+        std::cerr << "Unknown max-flow solver: " << options.maxflow
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    //kmc.run_gomory_hu();
-    kmc.run_gomory_hu_2();
-    kmc.min_k_cut_value(3);
+// Run the pipeline on every graph of a batch, and write one JSON record per
+// graph to stdout, in the order they finish, with its file in "graph" and
+// its exit status in "status". Nothing else is written.
+//
+// Each graph is a job on a pool of n_threads workers, and runs on one
+// thread, while a loader thread reads and simplifies the next graphs.
+int run_batch(std::string const& input, run_options options)
+{
+    timer t_total;
+    std::vector<std::string> files;
+    if (!batch_files(input, files))
+        return 1;
+    unsigned const n_workers = std::max(1u, options.n_threads);
+    options.n_threads = 1;
+    options.batch = true;
+    // Cache writing and the files of one graph make no sense for many
+    options.cache_file.clear();
+    options.tree_file.clear();
+    options.map_ks.clear();
+    options.dendrogram_file.clear();
 
-    ListGraph::NodeMap<unsigned int> cut_colors(g);
-    kmc.min_k_cut_map(3, cut_colors);
+    std::size_t n_failed = run_batch_jobs(
+        files, n_workers,
+        [&options](std::string const& file, int& n,
+            std::vector<csr_graph::edge>& edges) {
+            return load_graph(file, options, n, edges);
+        },
+        [&options](int n, std::vector<csr_graph::edge>& edges) {
+            return run_graph(n, edges, options);
+        });
 
-    // write original graph to dot file
-    std::ofstream dot_file("graph.dot");
-    writeDotGraph(g, weights, dot_file);
-    //writeDotGraph(g, weights);
+    global_json_logger.add("batch_time_total", t_total.tick());
+    global_json_logger.add("batch_n_graphs", files.size());
+    global_json_logger.add("batch_n_failed", n_failed);
+    global_json_logger.add("batch_threads", n_workers);
+    return n_failed == 0 ? 0 : 1;
+}
 
-    // write Gomory-Hu tree to dot file
-    std::ofstream dot_file_gh("graph_gh.dot");
-    writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels, dot_file_gh);
-    //writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels);
+int main(int argc, char** argv)
+{
+    std::string graph_file;
+    run_options options;
+    std::string serve_file;
+    std::string batch_input;
 
-    return 0;
-}
\ No newline at end of file
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            // Read signed, so that negative counts do not wrap around
+            int n_threads = std::stoi(argv[++i]);
+            if (n_threads < 1)
+            {
+                std::cerr << "--threads must be at least 1" << std::endl;
+                return 1;
+            }
+            options.n_threads = n_threads;
+        }
+        else if (arg == "--maxflow" && i + 1 < argc)
+        {
+            options.maxflow = argv[++i];
+        }
+        else if (arg == "--engine" && i + 1 < argc)
+        {
+            options.engine = argv[++i];
+        }
+        else if (arg == "--trials" && i + 1 < argc)
+        {
+            int n_trials = std::stoi(argv[++i]);
+            if (n_trials < 1)
+            {
+                std::cerr << "--trials must be at least 1" << std::endl;
+                return 1;
+            }
+            options.n_trials = n_trials;
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            options.seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--k" && i + 1 < argc)
+        {
+            options.k = std::max(2, std::stoi(argv[++i]));
+        }
+        else if (arg == "--cut-maps" && i + 1 < argc)
+        {
+            // A comma separated list of k
+            std::istringstream ks(argv[++i]);
+            std::string k;
+            while (std::getline(ks, k, ','))
+            {
+                options.map_ks.push_back(std::stoi(k));
+            }
+        }
+        else if (arg == "--dendrogram" && i + 1 < argc)
+        {
+            options.dendrogram_file = argv[++i];
+        }
+        else if (arg == "--no-reduction")
+        {
+            options.reduce = false;
+        }
+        else if (arg == "--blocks")
+        {
+            options.blocks = true;
+        }
+        else if (arg == "--write-cache" && i + 1 < argc)
+        {
+            options.cache_file = argv[++i];
+        }
+        else if (arg == "--write-tree" && i + 1 < argc)
+        {
+            options.tree_file = argv[++i];
+        }
+        else if (arg == "--certificate" && i + 1 < argc)
+        {
+            options.certificate = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+        {
+            serve_file = argv[++i];
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_input = argv[++i];
+        }
+        else if (arg == "--perf-counters")
+        {
+            perf_counters::enabled() = true;
+        }
+        else
+        {
+            graph_file = arg;
+        }
+    }
+
+    if (!serve_file.empty())
+        return serve_queries(serve_file);
+
+    // Without counters, only times are logged
+    if (perf_counters::enabled())
+        global_json_logger.add(
+            "perf_counters", perf_counters::this_thread().available());
+
+    if (!batch_input.empty())
+        return run_batch(batch_input, options);
+
+    if (graph_file.empty())
+    {
+        std::cout << "Benchmark of min-k-cut algorithm using Gomory-Hu Tree"
+                  << std::endl;
+        std::cout << "Usage: " << argv[0]
+                  << " [--threads <n>] [--maxflow <solver>] [--k <k>]"
+                     " [--no-reduction]"
+                     " [--blocks] [--write-cache <file>] [--write-tree <file>]"
+                     " [--cut-maps <k,k,...>] [--dendrogram <file>]"
+                     " [--certificate <lambda|auto>]"
+                     " [--engine <engine>] [--trials <n>] [--seed <s>]"
+                     " [--perf-counters] <graph_file>"
+                  << std::endl;
+        std::cout << "       " << argv[0] << " --serve <tree_file>"
+                  << std::endl;
+        std::cout << "       " << argv[0]
+                  << " [options] --batch <directory|manifest>" << std::endl;
+        std::cout << "The graph file is a DIMACS file, or a graph cache "
+                     "written by --write-cache, which is loaded without "
+                     "parsing"
+                  << std::endl;
+        std::cout << "Solvers: push-relabel (default), preflow, dinic, bk, "
+                     "pseudoflow"
+                  << std::endl;
+        std::cout << "--certificate runs on a Nagamochi-Ibaraki sparse "
+                     "certificate, which keeps the cuts up to lambda: only "
+                     "the min k-cut values up to --k are exact, if they are "
+                     "at most lambda, which auto makes sure of; the tree "
+                     "would not be, so it cannot be used with --write-tree, "
+                     "--cut-maps or --dendrogram"
+                  << std::endl;
+        std::cout << "Engines: gomory-hu (default), karger-stein, which "
+                     "runs --trials randomized contractions and ignores the "
+                     "tree options"
+                  << std::endl;
+        std::cout << "With --k 2, and nothing that needs the tree, the min "
+                     "cut is found by Stoer-Wagner instead"
+                  << std::endl;
+        std::cout << "--serve answers 'cut <s> <t>' and 'kcut <k>' lines "
+                     "from stdin on a tree saved by --write-tree"
+                  << std::endl;
+        std::cout << "--perf-counters adds the cycles, instructions, LLC "
+                     "misses and branch misses of the read, simplify, "
+                     "min-cut and relabel phases, where perf_event_open "
+                     "is allowed; they count the threads doing the work of "
+                     "each phase, including the thread pools that read and "
+                     "simplify start"
+                  << std::endl;
+        std::cout << "--batch runs every graph of a directory, or listed one "
+                     "per line in a manifest, as jobs on --threads workers, "
+                     "and writes one JSON record per graph; the file options "
+                     "are ignored"
+                  << std::endl;
+        return 1;
+    }
+
+    // The tree of a certificate is not a Gomory-Hu tree of the graph
+    if (!options.certificate.empty() &&
+        (!options.tree_file.empty() || !options.map_ks.empty() ||
+            !options.dendrogram_file.empty()))
+    {
+        std::cerr << "--certificate cannot be used with --write-tree, "
+                     "--cut-maps or --dendrogram"
+                  << std::endl;
+        return 1;
+    }
+
+    int n;
+    std::vector<csr_graph::edge> edges;
+    if (!load_graph(graph_file, options, n, edges))
+        return 1;
+    return run_graph(n, edges, options);
+}
@@ -1,13 +1,1023 @@
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <lemon/lgf_reader.h>
 #include <lemon/list_graph.h>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include "boykov_kolmogorov.hpp"
+#include "dinic.hpp"
 #include "dot_writer.hpp"
+#include "gomory_hu_tree.hpp"
 #include "k_min_cut.hpp"
+#include "karger_stein.hpp"
+#include "lemon_preflow.hpp"
 #include "mtx_reader.hpp"
+#include "pseudoflow.hpp"
+#include "thread_pool.hpp"
 #include "util.hpp"
 
 using namespace lemon;
 
+// A connected random graph: a path through all nodes, plus random edges
+void random_graph(ListGraph& g, ListGraph::EdgeMap<int>& weights, int n, int m,
+    unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    std::uniform_int_distribution<int> weight(1, 100);
+
+    g.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        g.addNode();
+    }
+    for (int i = 1; i < n; ++i)
+    {
+        auto e = g.addEdge(g.nodeFromId(i - 1), g.nodeFromId(i));
+        weights[e] = weight(gen);
+    }
+    for (int i = n - 1; i < m; ++i)
+    {
+        int u = node(gen);
+        int v = node(gen);
+        if (u == v)
+            continue;
+        auto e = g.addEdge(g.nodeFromId(u), g.nodeFromId(v));
+        weights[e] = weight(gen);
+    }
+}
+
+// The tree edges as (label, label, flow) triples, in a canonical order
+template <typename MaxFlow>
+std::vector<std::tuple<int, int, int>> tree_edges(k_min_cut<MaxFlow> const& kmc)
+{
+    std::vector<std::tuple<int, int, int>> edges;
+    for (ListGraph::EdgeIt e(kmc._tree); e != INVALID; ++e)
+    {
+        int u = kmc._tree_labels[kmc._tree.u(e)];
+        int v = kmc._tree_labels[kmc._tree.v(e)];
+        edges.emplace_back(std::min(u, v), std::max(u, v), kmc._tree_flows[e]);
+    }
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+bool test_parallel_gomory_hu()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 60, 300, 42);
+
+    k_min_cut serial(g, weights);
+    serial.run_gomory_hu();
+
+    for (unsigned n_threads : {2, 3, 8})
+    {
+        k_min_cut parallel(g, weights);
+        parallel.set_threads(n_threads);
+        parallel.run_gomory_hu();
+
+        if (tree_edges(serial) != tree_edges(parallel))
+        {
+            std::cerr << "test_parallel_gomory_hu: tree with " << n_threads
+                      << " threads differs from the serial tree" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Gusfield's algorithm as published, re-pointing by a scan of every node,
+// as tree edges in the format of tree_edges
+std::vector<std::tuple<int, int, int>> reference_gusfield(
+    ListGraph const& g, ListGraph::EdgeMap<int> const& weights)
+{
+    csr_graph csr;
+    std::vector<ListGraph::Node> nodes;
+    csr.build(g, weights, nodes);
+    int const n = csr.n_nodes();
+    std::vector<int> p(n, 0);
+    std::vector<int> fl(n, 0);
+    p[0] = -1;
+    push_relabel flow;
+    for (int s = 1; s < n; ++s)
+    {
+        int t = p[s];
+        flow.run(csr, s, t);
+        fl[s] = static_cast<int>(flow.flow_value());
+        for (int i = 0; i < n; ++i)
+        {
+            if (i != s && flow.min_cut(i) && p[i] == t)
+                p[i] = s;
+        }
+        if (p[t] != -1 && flow.min_cut(p[t]))
+        {
+            p[s] = p[t];
+            p[t] = s;
+            fl[s] = fl[t];
+            fl[t] = static_cast<int>(flow.flow_value());
+        }
+    }
+
+    std::vector<std::tuple<int, int, int>> edges;
+    for (int i = 1; i < n; ++i)
+    {
+        int u = g.id(nodes[i]);
+        int v = g.id(nodes[p[i]]);
+        edges.emplace_back(std::min(u, v), std::max(u, v), fl[i]);
+    }
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+// Stars keep most nodes children of the root, or of a hub, for many flows:
+// the commit walks the s side of the cut instead of the children of t, and
+// must give the tree of the published algorithm
+bool test_gusfield_stars()
+{
+    int const n = 300;
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    std::mt19937 gen(23);
+    std::uniform_int_distribution<int> weight(1, 20);
+    for (int i = 0; i < n; ++i)
+    {
+        g.addNode();
+    }
+    // Leaves hang from node 0 and three other hubs, which are joined
+    int const hubs[] = {0, 1, 2, 3};
+    for (int i = 1; i < 4; ++i)
+    {
+        weights[g.addEdge(g.nodeFromId(0), g.nodeFromId(i))] = 50;
+    }
+    for (int i = 4; i < n; ++i)
+    {
+        int hub = hubs[gen() % 4];
+        weights[g.addEdge(g.nodeFromId(hub), g.nodeFromId(i))] = weight(gen);
+    }
+    for (int i = 0; i < 30; ++i)
+    {
+        int u = 4 + int(gen() % (n - 4));
+        int v = 4 + int(gen() % (n - 4));
+        if (u != v)
+            weights[g.addEdge(g.nodeFromId(u), g.nodeFromId(v))] = weight(gen);
+    }
+
+    auto expected = reference_gusfield(g, weights);
+    for (unsigned n_threads : {1, 4})
+    {
+        k_min_cut kmc(g, weights);
+        kmc.set_threads(n_threads);
+        kmc.run_gomory_hu();
+        if (tree_edges(kmc) != expected)
+        {
+            std::cerr << "test_gusfield_stars: tree with " << n_threads
+                      << " threads differs from the reference" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The supernode splits run as tasks on the pool; contracted nodes are
+// numbered canonically, so the tree must not depend on the thread count
+bool test_parallel_gomory_hu_2()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 60, 300, 43);
+
+    k_min_cut serial(g, weights);
+    serial.run_gomory_hu_2();
+
+    for (unsigned n_threads : {2, 3, 8})
+    {
+        for (int run = 0; run < 3; ++run)
+        {
+            k_min_cut parallel(g, weights);
+            parallel.set_threads(n_threads);
+            parallel.run_gomory_hu_2();
+
+            if (tree_edges(serial) != tree_edges(parallel))
+            {
+                std::cerr << "test_parallel_gomory_hu_2: tree with "
+                          << n_threads
+                          << " threads differs from the serial tree"
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The min cut value of every pair of nodes, read off the tree: the
+// smallest flow on the tree path between them. Indexed by label.
+template <typename MaxFlow>
+std::vector<std::vector<int>> pair_cut_values(k_min_cut<MaxFlow> const& kmc)
+{
+    int n = countNodes(kmc._tree);
+    std::vector<std::vector<int>> values(n, std::vector<int>(n, 0));
+    for (ListGraph::NodeIt root(kmc._tree); root != INVALID; ++root)
+    {
+        // DFS from root, carrying the smallest flow on the path
+        std::vector<std::pair<ListGraph::Node, int>> stack{
+            {root, std::numeric_limits<int>::max()}};
+        ListGraph::NodeMap<bool> visited(kmc._tree, false);
+        visited[root] = true;
+        while (!stack.empty())
+        {
+            auto [u, path_min] = stack.back();
+            stack.pop_back();
+            values[kmc._tree_labels[root]][kmc._tree_labels[u]] = path_min;
+            for (ListGraph::IncEdgeIt e(kmc._tree, u); e != INVALID; ++e)
+            {
+                ListGraph::Node v = kmc._tree.oppositeNode(u, e);
+                if (!visited[v])
+                {
+                    visited[v] = true;
+                    stack.emplace_back(
+                        v, std::min(path_min, kmc._tree_flows[e]));
+                }
+            }
+        }
+    }
+    return values;
+}
+
+// Every solver must give trees with the same pairwise min cut values. The
+// trees themselves may differ when min cuts are not unique.
+template <typename MaxFlow>
+bool test_max_flow_backend(char const* name,
+    std::vector<std::vector<int>> const& expected, ListGraph const& g,
+    ListGraph::EdgeMap<int> const& weights)
+{
+    k_min_cut<MaxFlow> gusfield(g, weights);
+    gusfield.run_gomory_hu();
+    k_min_cut<MaxFlow> splitting(g, weights);
+    splitting.set_threads(3);
+    splitting.run_gomory_hu_2();
+
+    if (pair_cut_values(gusfield) != expected ||
+        pair_cut_values(splitting) != expected)
+    {
+        std::cerr << "test_max_flow_backends: " << name
+                  << " gives different min cut values" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool test_max_flow_backends()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 50, 200, 7);
+
+    k_min_cut<lemon_preflow> reference(g, weights);
+    reference.run_gomory_hu();
+    auto expected = pair_cut_values(reference);
+
+    return test_max_flow_backend<push_relabel>(
+               "push_relabel", expected, g, weights) &&
+        test_max_flow_backend<dinic>("dinic", expected, g, weights) &&
+        test_max_flow_backend<boykov_kolmogorov>(
+            "boykov_kolmogorov", expected, g, weights) &&
+        test_max_flow_backend<pseudoflow>("pseudoflow", expected, g, weights);
+}
+
+// True if every edge of the tree has the weight of its fundamental cut in g
+template <typename MaxFlow>
+bool is_cut_tree(k_min_cut<MaxFlow> const& kmc, ListGraph const& g,
+    ListGraph::EdgeMap<int> const& weights)
+{
+    for (ListGraph::EdgeIt cut(kmc._tree); cut != INVALID; ++cut)
+    {
+        // The side of the tree that holds u(cut), by graph node id
+        std::vector<char> side(g.maxNodeId() + 1, 0);
+        std::vector<ListGraph::Node> stack{kmc._tree.u(cut)};
+        ListGraph::NodeMap<bool> visited(kmc._tree, false);
+        visited[kmc._tree.u(cut)] = true;
+        while (!stack.empty())
+        {
+            ListGraph::Node u = stack.back();
+            stack.pop_back();
+            side[kmc._tree_labels[u]] = 1;
+            for (ListGraph::IncEdgeIt e(kmc._tree, u); e != INVALID; ++e)
+            {
+                ListGraph::Node v = kmc._tree.oppositeNode(u, e);
+                if (e != cut && !visited[v])
+                {
+                    visited[v] = true;
+                    stack.push_back(v);
+                }
+            }
+        }
+
+        int value = 0;
+        for (ListGraph::EdgeIt e(g); e != INVALID; ++e)
+        {
+            if (side[g.id(g.u(e))] != side[g.id(g.v(e))])
+                value += weights[e];
+        }
+        if (value != kmc._tree_flows[cut])
+            return false;
+    }
+    return true;
+}
+
+// A random graph with chains between random nodes and pendant trees
+void chain_graph(ListGraph& g, ListGraph::EdgeMap<int>& weights, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> weight(1, 100);
+    random_graph(g, weights, 20, 50, seed);
+
+    for (int chain = 0; chain < 8; ++chain)
+    {
+        std::uniform_int_distribution<int> node(0, countNodes(g) - 1);
+        ListGraph::Node end = g.nodeFromId(node(gen));
+        ListGraph::Node u = g.nodeFromId(node(gen));
+        for (int i = 0; i < 1 + chain; ++i)
+        {
+            ListGraph::Node v = g.addNode();
+            weights[g.addEdge(u, v)] = weight(gen);
+            u = v;
+        }
+        // Half the chains are closed, the others are pendant paths
+        if (chain % 2 == 0 && u != end)
+            weights[g.addEdge(u, end)] = weight(gen);
+    }
+    for (int leaf = 0; leaf < 15; ++leaf)
+    {
+        std::uniform_int_distribution<int> node(0, countNodes(g) - 1);
+        ListGraph::Node u = g.nodeFromId(node(gen));
+        weights[g.addEdge(u, g.addNode())] = weight(gen);
+    }
+}
+
+// The tree of the reduced graph, put back together, must be a Gomory-Hu tree
+// of the whole graph
+bool test_graph_reduction()
+{
+    for (unsigned seed = 1; seed <= 20; ++seed)
+    {
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        chain_graph(g, weights, seed);
+
+        k_min_cut<lemon_preflow> reference(g, weights);
+        reference.run_gomory_hu();
+        auto expected = pair_cut_values(reference);
+
+        k_min_cut gusfield(g, weights);
+        gusfield.set_reduction(true);
+        gusfield.run_gomory_hu();
+        k_min_cut splitting(g, weights);
+        splitting.set_reduction(true);
+        splitting.set_threads(3);
+        splitting.run_gomory_hu_2();
+
+        for (auto* kmc : {&gusfield, &splitting})
+        {
+            if (pair_cut_values(*kmc) != expected ||
+                !is_cut_tree(*kmc, g, weights))
+            {
+                std::cerr << "test_graph_reduction: wrong tree for seed "
+                          << seed << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Long closed chains on a small core: every node of a chain but the last
+// comes back by a split
+bool test_graph_reduction_long_chains()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 20, 50, 11);
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> weight(1, 100);
+    for (int chain = 0; chain < 4; ++chain)
+    {
+        ListGraph::Node u = g.nodeFromId(chain);
+        for (int i = 0; i < 300; ++i)
+        {
+            ListGraph::Node v = g.addNode();
+            weights[g.addEdge(u, v)] = weight(gen);
+            u = v;
+        }
+        weights[g.addEdge(u, g.nodeFromId(10 + chain))] = weight(gen);
+    }
+
+    k_min_cut reference(g, weights);
+    reference.run_gomory_hu_2();
+    k_min_cut reduced(g, weights);
+    reduced.set_reduction(true);
+    reduced.run_gomory_hu_2();
+    if (pair_cut_values(reduced) != pair_cut_values(reference) ||
+        !is_cut_tree(reduced, g, weights))
+    {
+        std::cerr << "test_graph_reduction_long_chains: wrong tree"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Random blocks glued at single nodes, a second component, and an isolated
+// node
+void block_graph(ListGraph& g, ListGraph::EdgeMap<int>& weights, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> weight(1, 100);
+    std::uniform_int_distribution<int> size(2, 12);
+
+    g.clear();
+    auto add_block = [&](ListGraph::Node first, int n) {
+        std::vector<ListGraph::Node> nodes{first};
+        for (int i = 1; i < n; ++i)
+        {
+            nodes.push_back(g.addNode());
+            weights[g.addEdge(nodes[i - 1], nodes[i])] = weight(gen);
+        }
+        std::uniform_int_distribution<int> node(0, n - 1);
+        for (int i = 0; i < 2 * n; ++i)
+        {
+            ListGraph::Node u = nodes[node(gen)];
+            ListGraph::Node v = nodes[node(gen)];
+            if (u != v)
+                weights[g.addEdge(u, v)] = weight(gen);
+        }
+    };
+    for (int component = 0; component < 2; ++component)
+    {
+        ListGraph::Node root = g.addNode();
+        int first_id = g.id(root);
+        add_block(root, size(gen));
+        for (int block = 0; block < 6; ++block)
+        {
+            std::uniform_int_distribution<int> node(first_id, g.maxNodeId());
+            add_block(g.nodeFromId(node(gen)), size(gen));
+        }
+    }
+    g.addNode();
+}
+
+// Trees built block by block must be Gomory-Hu trees of the whole graph
+bool test_block_gomory_hu()
+{
+    for (unsigned seed = 1; seed <= 10; ++seed)
+    {
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        block_graph(g, weights, seed);
+
+        k_min_cut<lemon_preflow> reference(g, weights);
+        reference.run_gomory_hu();
+        auto expected = pair_cut_values(reference);
+
+        for (unsigned n_threads : {1, 3})
+        {
+            for (bool reduce : {false, true})
+            {
+                k_min_cut blocks(g, weights);
+                blocks.set_threads(n_threads);
+                blocks.set_reduction(reduce);
+                blocks.run_gomory_hu_blocks();
+                if (pair_cut_values(blocks) != expected ||
+                    !is_cut_tree(blocks, g, weights))
+                {
+                    std::cerr << "test_block_gomory_hu: wrong tree for seed "
+                              << seed << " with " << n_threads << " threads"
+                              << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// The query index must agree with the tree, one pair at a time and in a
+// batch, for both constructions
+bool test_cut_queries()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 50, 120, 11);
+
+    for (bool gusfield : {true, false})
+    {
+        k_min_cut kmc(g, weights);
+        kmc.set_reduction(true);
+        if (gusfield)
+            kmc.run_gomory_hu();
+        else
+            kmc.run_gomory_hu_2();
+        auto expected = pair_cut_values(kmc);
+
+        std::vector<std::pair<ListGraph::Node, ListGraph::Node>> pairs;
+        for (ListGraph::NodeIt s(g); s != INVALID; ++s)
+        {
+            for (ListGraph::NodeIt t(g); t != INVALID; ++t)
+            {
+                pairs.emplace_back(s, t);
+            }
+        }
+        std::vector<int> values;
+        kmc.min_cut_values(pairs, values);
+
+        for (std::size_t i = 0; i < pairs.size(); ++i)
+        {
+            auto [s, t] = pairs[i];
+            int value = expected[g.id(s)][g.id(t)];
+            if (kmc.min_cut_value(s, t) != value || values[i] != value)
+            {
+                std::cerr << "test_cut_queries: wrong cut between " << g.id(s)
+                          << " and " << g.id(t) << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The k-sweep must give the sums of the k-1 smallest tree flows, and cut
+// every tree edge once k exceeds the number of nodes
+bool test_k_sweep()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 30, 80, 5);
+
+    k_min_cut kmc(g, weights);
+    kmc.run_gomory_hu();
+
+    std::vector<long long> flows;
+    for (auto [u, v, flow] : tree_edges(kmc))
+    {
+        flows.push_back(flow);
+    }
+    std::sort(flows.begin(), flows.end());
+
+    unsigned int max_k = 40;
+    auto values = kmc.min_k_cut_values(max_k);
+    for (unsigned int k = 2; k <= max_k; ++k)
+    {
+        std::size_t n_cuts = std::min<std::size_t>(k - 1, flows.size());
+        long long expected =
+            std::accumulate(flows.begin(), flows.begin() + n_cuts, 0ll);
+        if (values[k] != expected || kmc.min_k_cut_value(k) != expected)
+        {
+            std::cerr << "test_k_sweep: wrong value for k = " << k
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The maps of several k from the dendrogram must each have k components,
+// separated by tree edges that add up to the min k-cut value
+bool test_cut_maps()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, 40, 100, 9);
+
+    k_min_cut kmc(g, weights);
+    kmc.run_gomory_hu_2();
+
+    std::vector<unsigned int> ks{7, 2, 40, 3, 12};
+    ListGraph::NodeMap<std::vector<unsigned int>> cut_maps(g);
+    kmc.min_k_cut_maps(ks, cut_maps);
+
+    for (std::size_t j = 0; j < ks.size(); ++j)
+    {
+        unsigned int n_components = 0;
+        for (ListGraph::NodeIt n(g); n != INVALID; ++n)
+        {
+            n_components = std::max(n_components, cut_maps[n][j]);
+        }
+        long long cut = 0;
+        for (ListGraph::EdgeIt e(kmc._tree); e != INVALID; ++e)
+        {
+            ListGraph::Node u =
+                g.nodeFromId(kmc._tree_labels[kmc._tree.u(e)]);
+            ListGraph::Node v =
+                g.nodeFromId(kmc._tree_labels[kmc._tree.v(e)]);
+            if (cut_maps[u][j] != cut_maps[v][j])
+                cut += kmc._tree_flows[e];
+        }
+        if (n_components != ks[j] || cut != kmc.min_k_cut_value(ks[j]))
+        {
+            std::cerr << "test_cut_maps: wrong map for k = " << ks[j]
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// A tree saved to a file and loaded back must answer every s-t and k-cut
+// query like the tree it was built from
+bool test_tree_artifact()
+{
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    block_graph(g, weights, 7);
+
+    k_min_cut kmc(g, weights);
+    kmc.run_gomory_hu_blocks();
+    auto expected = pair_cut_values(kmc);
+
+    std::string path =
+        (std::filesystem::temp_directory_path() / "test_k_min_cut.ght")
+            .string();
+    gomory_hu_tree saved;
+    saved.build(kmc._tree, kmc._tree_flows, kmc._tree_labels);
+    gomory_hu_tree tree;
+    bool success = saved.write(path) && tree.read(path);
+    std::filesystem::remove(path);
+
+    int n = countNodes(g);
+    for (int s = 0; success && s < n; ++s)
+    {
+        for (int t = 0; t < n; ++t)
+        {
+            if (tree.min_cut(tree.node(s), tree.node(t)) != expected[s][t])
+                success = false;
+        }
+    }
+    for (unsigned int k = 2; success && k <= 6; ++k)
+    {
+        if (tree.min_k_cut_value(k) != kmc.min_k_cut_value(k))
+            success = false;
+    }
+
+    if (!success)
+        std::cerr << "test_tree_artifact: loaded tree gives wrong cuts"
+                  << std::endl;
+    return success;
+}
+
+// The Stoer-Wagner fast path must find the min 2-cut of the tree, and a map
+// whose two sides are separated by edges of exactly that weight
+bool test_global_min_cut()
+{
+    for (unsigned seed : {1u, 2u, 3u})
+    {
+        ListGraph g;
+        ListGraph::EdgeMap<int> weights(g);
+        random_graph(g, weights, 40, 40 * seed + 20, seed);
+
+        k_min_cut kmc(g, weights);
+        ListGraph::NodeMap<unsigned int> cut_map(g);
+        long long value = kmc.run_min_cut(cut_map);
+        kmc.run_gomory_hu();
+
+        long long cut = 0;
+        for (ListGraph::EdgeIt e(g); e != INVALID; ++e)
+        {
+            if (cut_map[g.u(e)] != cut_map[g.v(e)])
+                cut += weights[e];
+        }
+        if (value != kmc.min_k_cut_value(2) || cut != value)
+        {
+            std::cerr << "test_global_min_cut: wrong cut for seed " << seed
+                      << std::endl;
+            return false;
+        }
+    }
+
+    // Every cut of small graphs, with parallel edges, loops and zero
+    // weights, against the merges of the rounds
+    std::mt19937 gen(7);
+    for (int round = 0; round < 500; ++round)
+    {
+        int n = 2 + int(gen() % 8);
+        std::vector<csr_graph::edge> edges;
+        for (int i = int(gen() % (3 * n)); i > 0; --i)
+        {
+            edges.push_back(
+                {int(gen() % n), int(gen() % n), int(gen() % 6)});
+        }
+        csr_graph small;
+        small.build(n, edges);
+        stoer_wagner engine;
+        engine.run(small);
+
+        auto cut = [&](auto in_side) {
+            long long value = 0;
+            for (csr_graph::edge const& e : edges)
+            {
+                if (in_side(e.u) != in_side(e.v))
+                    value += e.weight;
+            }
+            return value;
+        };
+        long long best = std::numeric_limits<long long>::max();
+        for (int mask = 1; mask + 1 < (1 << n); ++mask)
+        {
+            best = std::min(
+                best, cut([mask](int u) { return (mask >> u) & 1; }));
+        }
+        int n_side = 0;
+        for (int u = 0; u < n; ++u)
+        {
+            n_side += engine.side(u);
+        }
+        if (engine.value() != best || n_side == 0 || n_side == n ||
+            cut([&](int u) { return engine.side(u); }) != best)
+        {
+            std::cerr << "test_global_min_cut: wrong cut of a graph of "
+                      << n << " nodes" << std::endl;
+            return false;
+        }
+    }
+
+    // Two components cost nothing to separate
+    csr_graph two;
+    two.build(4, {{0, 1, 5}, {2, 3, 7}});
+    stoer_wagner engine;
+    engine.run(two);
+    if (engine.value() != 0 || engine.side(0) != engine.side(1) ||
+        engine.side(0) == engine.side(2))
+    {
+        std::cerr << "test_global_min_cut: wrong cut of two components"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Karger-Stein must find the min k-cut of small graphs, checked against
+// every assignment of the nodes to k parts, and give the same cut on any
+// number of threads
+bool test_karger_stein()
+{
+    int const n = 8;
+    unsigned int const k = 3;
+    std::mt19937 gen(11);
+    std::vector<csr_graph::edge> edges;
+    for (int i = 0; i < 3 * n; ++i)
+    {
+        edges.push_back({int(gen() % n), int(gen() % n), int(gen() % 9 + 1)});
+    }
+    simplify_edges(n, edges);
+
+    long long best = std::numeric_limits<long long>::max();
+    std::vector<int> part(n, 0);
+    for (int code = 0; code < 6561; ++code)
+    {
+        std::vector<char> used(k, 0);
+        for (int u = 0, c = code; u < n; ++u, c /= k)
+        {
+            part[u] = c % k;
+            used[part[u]] = 1;
+        }
+        if (std::count(used.begin(), used.end(), 1) != int(k))
+            continue;
+        long long value = 0;
+        for (csr_graph::edge const& e : edges)
+        {
+            if (part[e.u] != part[e.v])
+                value += e.weight;
+        }
+        best = std::min(best, value);
+    }
+
+    karger_stein serial;
+    serial.set_trials(100);
+    karger_stein parallel;
+    parallel.set_trials(100);
+    parallel.set_threads(3);
+    long long value = serial.run(n, edges, k);
+    parallel.run(n, edges, k);
+
+    long long cut = 0;
+    for (csr_graph::edge const& e : edges)
+    {
+        if (serial.labels()[e.u] != serial.labels()[e.v])
+            cut += e.weight;
+    }
+    if (value != best || cut != value ||
+        *std::max_element(serial.labels().begin(), serial.labels().end()) !=
+            k ||
+        parallel.value() != value || parallel.labels() != serial.labels())
+    {
+        std::cerr << "test_karger_stein: wrong cut" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A tree kept current through weight changes and new edges must answer
+// every min cut query like a tree built from scratch on the changed graph
+bool test_tree_updates()
+{
+    int const n = 30;
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, n, 70, 13);
+
+    k_min_cut kmc(g, weights);
+    kmc.set_reduction(true);
+    kmc.run_gomory_hu_2();
+
+    std::mt19937 gen(17);
+    for (int step = 0; step < 30; ++step)
+    {
+        ListGraph::Node u = g.nodeFromId(int(gen() % n));
+        ListGraph::Node v = g.nodeFromId(int(gen() % n));
+        int delta = int(gen() % 50) + 1;
+        ListGraph::Edge e = findEdge(g, u, v);
+        if (u == v)
+            continue;
+        if (step % 3 == 0 && e != INVALID)
+        {
+            delta = std::min(delta, weights[e]);
+            weights[e] -= delta;
+            kmc.decrease_weight(u, v, delta);
+        }
+        else if (e != INVALID)
+        {
+            weights[e] += delta;
+            kmc.increase_weight(u, v, delta);
+        }
+        else
+        {
+            weights[g.addEdge(u, v)] = delta;
+            kmc.add_edge(u, v, delta);
+        }
+
+        k_min_cut fresh(g, weights);
+        fresh.run_gomory_hu();
+        for (ListGraph::NodeIt s(g); s != INVALID; ++s)
+        {
+            for (ListGraph::NodeIt t(g); t != INVALID; ++t)
+            {
+                if (kmc.min_cut_value(s, t) != fresh.min_cut_value(s, t))
+                {
+                    std::cerr << "test_tree_updates: wrong cut after step "
+                              << step << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// The value of a key of a written JSON record, or "" if it is missing
+std::string json_value(std::string const& record, std::string const& key)
+{
+    std::string prefix = "\"" + key + "\": \"";
+    std::size_t first = record.find(prefix);
+    if (first == std::string::npos)
+        return "";
+    first += prefix.size();
+    return record.substr(first, record.find('"', first) - first);
+}
+
+// The telemetry of a tree construction has one sample per committed flow,
+// and counts the pushes and relabels of push_relabel
+bool test_flow_telemetry()
+{
+    if (!flow_telemetry::enabled)
+        return true;
+
+    int const n = 40;
+    ListGraph g;
+    ListGraph::EdgeMap<int> weights(g);
+    random_graph(g, weights, n, 120, 19);
+
+    for (bool splits : {false, true})
+    {
+        json_logger record(false);
+        {
+            json_logger::redirect redirect(record);
+            k_min_cut kmc(g, weights);
+            if (splits)
+                kmc.run_gomory_hu_2();
+            else
+                kmc.run_gomory_hu();
+        }
+        std::ostringstream os;
+        record.write(os);
+
+        std::istringstream histogram(
+            json_value(os.str(), "gh_flow_time_histogram"));
+        int n_flows = 0;
+        for (int count; histogram >> count;)
+        {
+            n_flows += count;
+        }
+        std::istringstream slowest(json_value(os.str(), "gh_slowest_flows"));
+        int n_slowest = 0;
+        for (std::string flow; slowest >> flow;)
+        {
+            ++n_slowest;
+        }
+        if (n_flows != n - 1 || n_slowest != 5 ||
+            json_value(os.str(), "gh_flow_pushes") == "0" ||
+            json_value(os.str(), "gh_flow_time_p99").empty())
+        {
+            std::cerr << "test_flow_telemetry: wrong summary " << os.str()
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Differences and sums of perf samples, and the counts logged of them:
+// nothing when they are unavailable, as when the counters are off
+bool test_perf_counts()
+{
+    perf_sample start{10, 20, 30, 40, true};
+    perf_sample end{15, 45, 32, 41, true};
+    perf_sample d = end - start;
+    perf_sample total = d;
+    total += d;
+    perf_sample unavailable = end - perf_sample{};
+    perf_sample none;
+    none += perf_sample{};
+    if (d.cycles != 5 || d.instructions != 25 || d.llc_misses != 2 ||
+        d.branch_misses != 1 || !d.available || total.cycles != 10 ||
+        total.instructions != 50 || total.llc_misses != 4 ||
+        total.branch_misses != 2 || !total.available ||
+        unavailable.available || none.available)
+    {
+        std::cerr << "test_perf_counts: wrong arithmetic" << std::endl;
+        return false;
+    }
+
+    perf_scope scope;
+    json_logger record(false);
+    record.add_counts("off", scope.tick());
+    record.add_counts("none", perf_sample{});
+    record.add_counts("phase", d);
+    std::ostringstream os;
+    record.write(os);
+    if (os.str() !=
+        "{\"phase_cycles\": \"5\", \"phase_instructions\": \"25\", "
+        "\"phase_llc_misses\": \"2\", \"phase_branch_misses\": \"1\"}\n")
+    {
+        std::cerr << "test_perf_counts: wrong record " << os.str()
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// for_each_worker runs once on every worker, however fast the first ones are
+bool test_for_each_worker()
+{
+    thread_pool pool(4);
+    for (int round = 0; round < 3; ++round)
+    {
+        std::vector<int> runs(pool.size(), 0);
+        pool.for_each_worker([&](unsigned worker) { ++runs[worker]; });
+        if (std::count(runs.begin(), runs.end(), 1) != int(pool.size()))
+        {
+            std::cerr << "test_for_each_worker: a worker ran "
+                      << "more or less than once" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds are dropped while a discard lives, even into a redirected record
+bool test_json_discard()
+{
+    json_logger record(false);
+    json_logger::redirect redirect(record);
+    {
+        json_logger::discard discard;
+        global_json_logger.add("dropped", 1);
+        record.add_counts("dropped", perf_sample{1, 2, 3, 4, true});
+    }
+    global_json_logger.add("kept", 2);
+    std::ostringstream os;
+    record.write(os);
+    if (os.str() != "{\"kept\": \"2\"}\n")
+    {
+        std::cerr << "test_json_discard: wrong record " << os.str()
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
 int main()
 {
     char mtx_graph[] = "%%MatrixMarket matrix coordinate real general\n"
@@ -44,5 +1054,42 @@ int main()
     writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels, dot_file_gh);
     writeDotGraph(kmc._tree, kmc._tree_flows, kmc._tree_labels);
 
+    if (!test_parallel_gomory_hu())
+        return 1;
+    if (!test_parallel_gomory_hu_2())
+        return 1;
+    if (!test_gusfield_stars())
+        return 1;
+    if (!test_max_flow_backends())
+        return 1;
+    if (!test_graph_reduction())
+        return 1;
+    if (!test_graph_reduction_long_chains())
+        return 1;
+    if (!test_block_gomory_hu())
+        return 1;
+    if (!test_tree_artifact())
+        return 1;
+    if (!test_cut_queries())
+        return 1;
+    if (!test_k_sweep())
+        return 1;
+    if (!test_cut_maps())
+        return 1;
+    if (!test_global_min_cut())
+        return 1;
+    if (!test_karger_stein())
+        return 1;
+    if (!test_tree_updates())
+        return 1;
+    if (!test_flow_telemetry())
+        return 1;
+    if (!test_perf_counts())
+        return 1;
+    if (!test_json_discard())
+        return 1;
+    if (!test_for_each_worker())
+        return 1;
+
     return 0;
 }
\ No newline at end of file
@@ -1,8 +1,16 @@
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <lemon/lgf_reader.h>
 #include <lemon/list_graph.h>
+#include <map>
+#include <random>
+#include <tuple>
 #include "mtx_reader.hpp"
+#include "batch.hpp"
 #include "dimacs_reader.hpp"
+#include "edge_list.hpp"
+#include "graph_cache.hpp"
 
 using namespace lemon;
 
@@ -200,9 +208,412 @@ bool test_with_weights()
     return success;
 }
 
+// The memory-mapped readers must give the same graphs as the stream readers
+bool test_mapped_files()
+{
+    char test_mtx_graph[] = "%%MatrixMarket matrix coordinate real general\n"
+                            "% Sample graph in Matrix Market format\n"
+                            "5 5 7\r\n"
+                            "1 2 1\r\n"
+                            "2 3\n"
+                            "3 4 1\n"
+                            "1 4 5\n"
+                            "1 4 10\n"
+                            "1 4 7\n"
+                            "5 3 1";
+
+    char test_dimacs_graph[] = "c this is a comment line in a dimacs file\n"
+                               "p sp 5 7\n"
+                               "a 1 2 1\n"
+                               "a 2 3 1\n"
+                               "a 3 4 1\n"
+                               "c comments may come between arcs\n"
+                               "a 1 4 5\n"
+                               "a 1 4 10\n"
+                               "a 1 4 7\n"
+                               "a 5 3 1";
+
+    auto dir = std::filesystem::temp_directory_path();
+    std::string mtx_path = (dir / "test_readers.mtx").string();
+    std::string dimacs_path = (dir / "test_readers.gr").string();
+    std::ofstream(mtx_path) << test_mtx_graph;
+    std::ofstream(dimacs_path) << test_dimacs_graph;
+
+    ListGraph g_mtx, g_mtx_file, g_dimacs, g_dimacs_file;
+    ListGraph::EdgeMap<int> weights_mtx(g_mtx), weights_mtx_file(g_mtx_file),
+        weights_dimacs(g_dimacs), weights_dimacs_file(g_dimacs_file);
+
+    std::istringstream input_mtx(test_mtx_graph);
+    readMtxGraph(g_mtx, weights_mtx, input_mtx);
+    std::istringstream input_dimacs(test_dimacs_graph);
+    readDimacsGraph(g_dimacs, weights_dimacs, input_dimacs);
+
+    bool success = readMtxFile(g_mtx_file, weights_mtx_file, mtx_path) &&
+        readDimacsFile(g_dimacs_file, weights_dimacs_file, dimacs_path) &&
+        countEdges(g_mtx) == 7 && are_graphs_equal(g_mtx, g_mtx_file) &&
+        are_maps_equal(g_mtx, g_mtx_file, weights_mtx, weights_mtx_file) &&
+        are_graphs_equal(g_dimacs, g_dimacs_file) &&
+        are_maps_equal(
+            g_dimacs, g_dimacs_file, weights_dimacs, weights_dimacs_file);
+
+    // Out of range nodes are rejected
+    ListGraph g_bad;
+    ListGraph::EdgeMap<int> weights_bad(g_bad);
+    std::ofstream(dimacs_path) << "p sp 2 1\na 1 3 1\n";
+    if (readDimacsFile(g_bad, weights_bad, dimacs_path))
+        success = false;
+
+    std::filesystem::remove(mtx_path);
+    std::filesystem::remove(dimacs_path);
+
+    if (!success)
+        std::cerr << "'test_mapped_files()' failed" << std::endl;
+
+    return success;
+}
+
+bool are_edges_equal(std::vector<csr_graph::edge> const& a,
+    std::vector<csr_graph::edge> const& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](csr_graph::edge const& e, csr_graph::edge const& f) {
+            return e.u == f.u && e.v == f.v && e.weight == f.weight;
+        });
+}
+
+// Parsing in chunks on several threads must give the edges of a serial parse
+bool test_parallel_parsing()
+{
+    // Large enough to be split into several chunks
+    int const n = 1000;
+    int const m = 200000;
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> node(1, n);
+    std::uniform_int_distribution<int> weight(1, 100);
+
+    std::string dimacs = "c random graph\np sp " + std::to_string(n) + " " +
+        std::to_string(m) + "\n";
+    std::string mtx = "%%MatrixMarket matrix coordinate real general\n" +
+        std::to_string(n) + " " + std::to_string(n) + " " +
+        std::to_string(m) + "\n";
+    for (int i = 0; i < m; ++i)
+    {
+        std::string u = std::to_string(node(gen));
+        std::string v = std::to_string(node(gen));
+        std::string w = std::to_string(weight(gen));
+        if (i % 37 == 0)
+            dimacs += "c comment\n";
+        dimacs += "a " + u + " " + v + " " + w + "\n";
+        mtx += u + " " + v + (i % 3 ? " " + w : "") + "\r\n";
+    }
+    // Lines after the last entry are not parsed
+    dimacs += "not an arc\n";
+
+    bool success = true;
+    int n_serial, n_parallel;
+    std::vector<csr_graph::edge> serial, parallel;
+    char const* first = dimacs.data();
+    char const* last = first + dimacs.size();
+    parseDimacs(first, last, n_serial, serial, 1);
+    for (unsigned n_threads : {2, 3, 8})
+    {
+        if (!parseDimacs(first, last, n_parallel, parallel, n_threads) ||
+            serial.size() != std::size_t(m) ||
+            !are_edges_equal(serial, parallel))
+        {
+            std::cerr << "test_parallel_parsing: DIMACS edges do not match "
+                         "with "
+                      << n_threads << " threads" << std::endl;
+            success = false;
+        }
+    }
+
+    first = mtx.data();
+    last = first + mtx.size();
+    parseMtx(first, last, n_serial, serial, 1);
+    if (!parseMtx(first, last, n_parallel, parallel, 4) ||
+        serial.size() != std::size_t(m) || !are_edges_equal(serial, parallel))
+    {
+        std::cerr << "test_parallel_parsing: MTX edges do not match"
+                  << std::endl;
+        success = false;
+    }
+
+    // An invalid entry, or a missing one, fails on every thread count
+    std::string broken = dimacs;
+    broken[broken.find("\na ", broken.size() / 2) + 1] = '#';
+    std::string cut = dimacs.substr(0, dimacs.size() / 2);
+    for (std::string const& text : {broken, cut})
+    {
+        if (parseDimacs(text.data(), text.data() + text.size(), n_parallel,
+                parallel, 4))
+        {
+            std::cerr << "test_parallel_parsing: invalid data accepted"
+                      << std::endl;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+// A graph written to a graph cache must come back with the same nodes and
+// weighted edges, and a damaged cache must be rejected
+bool test_graph_cache()
+{
+    char test_dimacs_graph[] = "p sp 6 7\n"
+                               "a 1 2 1\n"
+                               "a 2 3 2\n"
+                               "a 3 4 3\n"
+                               "a 4 1 5\n"
+                               "a 1 4 10\n"
+                               "a 6 3 7\n"
+                               "a 2 2 4\n";
+
+    ListGraph g, g_cache;
+    ListGraph::EdgeMap<int> weights(g), weights_cache(g_cache);
+    std::istringstream input(test_dimacs_graph);
+    readDimacsGraph(g, weights, input);
+
+    std::string path =
+        (std::filesystem::temp_directory_path() / "test_readers.gc").string();
+    csr_graph csr;
+    std::vector<ListGraph::Node> nodes;
+    csr.build(g, weights, nodes);
+
+    // Edges as sorted (u, v, weight) triples with u < v. Loops are dropped.
+    auto edge_set = [](ListGraph const& h, ListGraph::EdgeMap<int> const& w) {
+        std::vector<std::tuple<int, int, int>> edges;
+        for (ListGraph::EdgeIt e(h); e != INVALID; ++e)
+        {
+            int u = h.id(h.u(e));
+            int v = h.id(h.v(e));
+            if (u != v)
+                edges.emplace_back(std::min(u, v), std::max(u, v), w[e]);
+        }
+        std::sort(edges.begin(), edges.end());
+        return edges;
+    };
+
+    bool success = writeGraphCache(csr, path) && isGraphCache(path) &&
+        readGraphCache(g_cache, weights_cache, path) &&
+        countNodes(g_cache) == 6 &&
+        edge_set(g, weights) == edge_set(g_cache, weights_cache);
+
+    // Flip a byte of the payload
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(sizeof(graph_cache_header) + 5);
+        f.put('\x7f');
+    }
+    if (readGraphCache(g_cache, weights_cache, path))
+        success = false;
+
+    std::filesystem::remove(path);
+
+    if (!success)
+        std::cerr << "'test_graph_cache()' failed" << std::endl;
+
+    return success;
+}
+
+// Loops must be dropped, and parallel and reverse arcs merged into one edge
+// with their summed weight, the same on every thread count
+bool test_simplify_edges()
+{
+    int const n = 500;
+    int const m = 20000;
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    std::uniform_int_distribution<int> weight(1, 100);
+
+    std::vector<csr_graph::edge> edges;
+    std::map<std::pair<int, int>, int> expected;
+    std::size_t n_loops = 0;
+    for (int i = 0; i < m; ++i)
+    {
+        int u = node(gen);
+        // Some loops
+        int v = i % 50 == 0 ? u : node(gen);
+        int w = weight(gen);
+        edges.push_back({u, v, w});
+        if (u == v)
+            ++n_loops;
+        else
+            expected[{std::min(u, v), std::max(u, v)}] += w;
+    }
+
+    bool success = true;
+    for (unsigned n_threads : {1, 2, 7})
+    {
+        std::vector<csr_graph::edge> simple = edges;
+        simplify_stats stats = simplify_edges(n, simple, n_threads);
+        bool equal = simple.size() == expected.size() &&
+            stats.n_loops == n_loops &&
+            stats.n_merged == edges.size() - n_loops - expected.size();
+        auto it = expected.begin();
+        for (std::size_t i = 0; equal && i < simple.size(); ++i, ++it)
+        {
+            equal = simple[i].u == it->first.first &&
+                simple[i].v == it->first.second &&
+                simple[i].weight == it->second;
+        }
+        if (!equal)
+        {
+            std::cerr << "'test_simplify_edges()' failed with " << n_threads
+                      << " threads" << std::endl;
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+// Every cut of value at most lambda must keep its value in the
+// certificate, and every other cut must keep at least lambda
+bool test_sparse_certificate()
+{
+    int const n = 12;
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> weight(1, 9);
+    std::vector<csr_graph::edge> edges;
+    for (int u = 0; u < n; ++u)
+    {
+        for (int v = u + 1; v < n; ++v)
+        {
+            // Dense, but with a sparse cluster 0..3
+            if (v >= 4 || gen() % 3 == 0)
+                edges.push_back({u, v, weight(gen)});
+        }
+    }
+
+    auto cut_value = [](std::vector<csr_graph::edge> const& es, unsigned s) {
+        long long value = 0;
+        for (csr_graph::edge const& e : es)
+        {
+            if (((s >> e.u) & 1) != ((s >> e.v) & 1))
+                value += e.weight;
+        }
+        return value;
+    };
+
+    bool success = true;
+    for (long long lambda : {1ll, 10ll, 40ll})
+    {
+        std::vector<csr_graph::edge> certificate = edges;
+        sparse_certificate(n, certificate, lambda);
+        long long total = 0;
+        for (csr_graph::edge const& e : certificate)
+        {
+            total += e.weight;
+        }
+        if (total > lambda * (n - 1))
+            success = false;
+        for (unsigned s = 1; s + 1 < (1u << n); ++s)
+        {
+            long long value = cut_value(edges, s);
+            long long kept = cut_value(certificate, s);
+            if (value <= lambda ? kept != value : kept < lambda)
+                success = false;
+        }
+    }
+
+    if (!success)
+        std::cerr << "'test_sparse_certificate()' failed" << std::endl;
+
+    return success;
+}
+
+// The files of a directory and of a manifest, and one record per job,
+// written to os, with what its load and run logged, its file and status
+bool test_batch()
+{
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "test_readers_batch";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string a = (dir / "a.gr").string();
+    std::string b = (dir / "b.gr").string();
+    std::string missing = (dir / "missing.gr").string();
+    std::ofstream(a) << "p sp 3 2\na 1 2 4\na 2 3 5\n";
+    std::ofstream(b) << "p sp 4 3\na 1 2 1\na 2 3 1\na 3 4 1\n";
+    std::ofstream(dir / ".hidden") << "p sp 1 0\n";
+
+    bool success = true;
+    std::vector<std::string> files;
+    if (!batch_files(dir.string(), files) ||
+        files != std::vector<std::string>{a, b})
+        success = false;
+
+    // Comments, blank lines, blanks around the names and CRLF line ends
+    std::string manifest = (dir / "manifest").string();
+    std::ofstream(manifest) << "# graphs\r\n" << a << "\r\n\r\n  " << b
+                            << " \t\r\n\t" << missing << "\n";
+    files.clear();
+    if (!batch_files(manifest, files) ||
+        files != std::vector<std::string>{a, b, missing})
+        success = false;
+    files.clear();
+    if (batch_files((dir / "none").string(), files))
+        success = false;
+
+    // The loads and runs log from the loader and the workers
+    files = {a, b, missing};
+    std::ostringstream os;
+    std::size_t n_failed = run_batch_jobs(
+        files, 2,
+        [](std::string const& file, int& n,
+            std::vector<csr_graph::edge>& edges) {
+            if (!readDimacsEdges(file, n, edges))
+                return false;
+            global_json_logger.add("n_nodes", n);
+            return true;
+        },
+        [](int, std::vector<csr_graph::edge>& edges) {
+            global_json_logger.add("n_edges", edges.size());
+            return 0;
+        },
+        os);
+
+    // The record of each file, by its "graph"
+    auto value = [](std::string const& record, std::string const& key) {
+        std::string prefix = "\"" + key + "\": \"";
+        std::size_t first = record.find(prefix);
+        if (first == std::string::npos)
+            return std::string();
+        first += prefix.size();
+        return record.substr(first, record.find('"', first) - first);
+    };
+    std::map<std::string, std::string> records;
+    std::istringstream lines(os.str());
+    for (std::string line; std::getline(lines, line);)
+    {
+        records[value(line, "graph")] = line;
+    }
+    if (n_failed != 1 || records.size() != 3 ||
+        value(records[a], "n_nodes") != "3" ||
+        value(records[a], "n_edges") != "2" ||
+        value(records[a], "status") != "0" ||
+        value(records[b], "n_nodes") != "4" ||
+        value(records[b], "n_edges") != "3" ||
+        value(records[b], "status") != "0" ||
+        value(records[missing], "status") != "1" ||
+        !value(records[missing], "n_edges").empty())
+        success = false;
+
+    fs::remove_all(dir);
+
+    if (!success)
+        std::cerr << "'test_batch()' failed" << std::endl;
+
+    return success;
+}
+
 int main() {
     
-    if (test() && test_with_weights())
+    if (test() && test_with_weights() && test_mapped_files() &&
+        test_parallel_parsing() && test_graph_cache() &&
+        test_simplify_edges() && test_sparse_certificate() && test_batch())
         return 0;
     return 1;
 }
\ No newline at end of file